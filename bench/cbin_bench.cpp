@@ -0,0 +1,73 @@
+// Throughput of the .cbin frame codec against its bit-at-a-time reference.
+// Build with -DLEDCUBEEDITOR_BENCH=ON and run `cbin_bench`.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "cbin_stream.h"
+
+struct Case
+{
+    const char *name;
+    CubeSize size;
+    int depth;
+    double density; // share of lit LEDs
+};
+
+template <typename Body>
+static double secondsFor(int repeats, Body body)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i)
+        body();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    const Case cases[] = {
+        {"8x8x8 on/off, half lit", CubeSize{8, 8, 8}, 1, 0.5},
+        {"8x8x8 on/off, sparse", CubeSize{8, 8, 8}, 1, 0.02},
+        {"16x16x16 on/off, half lit", CubeSize{16, 16, 16}, 1, 0.5},
+        {"20x20x20 4-bit, half lit", CubeSize{20, 20, 20}, 4, 0.5},
+        {"64x64x64 4-bit, sparse", CubeSize{64, 64, 64}, 4, 0.02},
+    };
+    std::mt19937 rng(1);
+    for (const Case &c : cases)
+    {
+        const CubeSize &size = c.size;
+        Frame frame(size, c.depth);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        for (int z = 0; z < size.z; ++z)
+            for (int y = 0; y < size.y; ++y)
+                for (int x = 0; x < size.x; ++x)
+                    if (chance(rng) < c.density)
+                        frame.setValue(x, y, z, 1 + (int)(rng() % frame.maxValue()));
+        CbinHeader header;
+        header.size = size;
+        header.depth = c.depth;
+        std::vector<uint8_t> fast(header.frameBytes()), reference(header.frameBytes());
+        encodeCbinFrame(frame, fast.data());
+        encodeCbinFrameReference(frame, reference.data());
+        Frame decoded(size, c.depth);
+        decodeCbinFrame(fast.data(), decoded);
+        bool same = fast == reference && decoded == frame;
+
+        // Aim for roughly the same amount of data per case
+        int repeats = std::max(16, (int)(64u * 1024 * 1024 / fast.size()));
+        Frame scratch(size, c.depth);
+        double times[4] = {
+            secondsFor(repeats / 8, [&] { encodeCbinFrameReference(frame, reference.data()); }) * 8,
+            secondsFor(repeats, [&] { encodeCbinFrame(frame, fast.data()); }),
+            secondsFor(repeats / 8, [&] { scratch.clear(); decodeCbinFrameReference(fast.data(), scratch); }) * 8,
+            secondsFor(repeats, [&] { scratch.clear(); decodeCbinFrame(fast.data(), scratch); }),
+        };
+        double megabytes = (double)repeats * fast.size() / (1024 * 1024);
+        std::printf("%s%s\n", c.name, same ? "" : " MISMATCH");
+        std::printf("  encode  reference %8.1f MB/s  fast %8.1f MB/s  x%.1f\n", megabytes / times[0],
+                    megabytes / times[1], times[0] / times[1]);
+        std::printf("  decode  reference %8.1f MB/s  fast %8.1f MB/s  x%.1f\n", megabytes / times[2],
+                    megabytes / times[3], times[2] / times[3]);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -1,9 +1,8 @@
 // fragment.glsl
 #version 330 core
+in vec3 vColor;
 out vec4 FragColor;
 
-uniform vec3 color;
-
 void main() {
-    FragColor = vec4(color, 1.0);
+    FragColor = vec4(vColor, 1.0);
 }
\ No newline at end of file
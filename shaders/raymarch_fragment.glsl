@@ -0,0 +1,71 @@
+// raymarch_fragment.glsl
+#version 330 core
+in vec2 vNdc;
+out vec4 FragColor;
+
+uniform mat4 invViewProj;
+uniform vec3 cameraPos;
+uniform ivec3 size;
+uniform samplerBuffer palette; // RGB cubes: color per voxel value
+uniform bool usePalette;
+uniform vec3 color;
+
+#include "voxel_bits.glsl"
+
+void main() {
+    vec4 farPoint = invViewProj * vec4(vNdc, 1.0, 1.0);
+    vec3 dir = normalize(farPoint.xyz / farPoint.w - cameraPos);
+    dir = mix(dir, vec3(1e-6), lessThan(abs(dir), vec3(1e-6)));
+
+    // Grid space: voxel i covers [i, i + 1) on every axis
+    vec3 origin = cameraPos + 0.5;
+    vec3 invDir = 1.0 / dir;
+    vec3 t0 = -origin * invDir;
+    vec3 t1 = (vec3(size) - origin) * invDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+    float tExit = min(min(tFar.x, tFar.y), tFar.z);
+    if (tEnter >= tExit)
+        discard;
+
+    ivec3 stepDir = ivec3(sign(dir));
+    vec3 tDelta = abs(invDir);
+    ivec3 cell = clamp(ivec3(floor(origin + dir * (tEnter + 1e-4))), ivec3(0), size - 1);
+    vec3 tNext = (vec3(cell) + max(vec3(stepDir), 0.0) - origin) * invDir;
+
+    vec3 normal = vec3(0.0);
+    if (tEnter == tNear.x) normal = vec3(-stepDir.x, 0.0, 0.0);
+    else if (tEnter == tNear.y) normal = vec3(0.0, -stepDir.y, 0.0);
+    else normal = vec3(0.0, 0.0, -stepDir.z);
+
+    // Amanatides-Woo DDA, one word fetch per visited voxel
+    int maxSteps = size.x + size.y + size.z;
+    for (int i = 0; i < maxSteps; ++i) {
+        int value = voxelValue(cell);
+        if (value > 0) {
+            vec3 base = usePalette ? texelFetch(palette, value).rgb
+                                   : color * float(value) / float((1 << depth) - 1);
+            vec3 lightDir = normalize(vec3(-0.4, 0.3, 0.85));
+            float diffuse = max(dot(normal, lightDir), 0.0);
+            FragColor = vec4(base * (0.35 + 0.65 * diffuse), 1.0);
+            return;
+        }
+        if (tNext.x < tNext.y && tNext.x < tNext.z) {
+            cell.x += stepDir.x;
+            tNext.x += tDelta.x;
+            normal = vec3(-stepDir.x, 0.0, 0.0);
+        } else if (tNext.y < tNext.z) {
+            cell.y += stepDir.y;
+            tNext.y += tDelta.y;
+            normal = vec3(0.0, -stepDir.y, 0.0);
+        } else {
+            cell.z += stepDir.z;
+            tNext.z += tDelta.z;
+            normal = vec3(0.0, 0.0, -stepDir.z);
+        }
+        if (any(lessThan(cell, ivec3(0))) || any(greaterThanEqual(cell, size)))
+            break;
+    }
+    discard;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+// raymarch_vertex.glsl
+#version 330 core
+// Full-screen triangle generated from gl_VertexID, drawn without vertex buffers
+out vec2 vNdc;
+
+void main() {
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    vNdc = pos;
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
\ No newline at end of file
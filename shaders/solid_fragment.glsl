@@ -0,0 +1,18 @@
+// solid_fragment.glsl
+#version 330 core
+in vec3 vNormal;
+flat in int vValue;
+out vec4 FragColor;
+
+uniform vec3 color;
+uniform float maxValue;
+uniform samplerBuffer palette; // RGB cubes: color per voxel value
+uniform bool usePalette;
+
+void main() {
+    // Fixed light from above and behind the default camera, plus ambient
+    vec3 lightDir = normalize(vec3(-0.4, 0.3, 0.85));
+    float diffuse = max(dot(normalize(vNormal), lightDir), 0.0);
+    vec3 base = usePalette ? texelFetch(palette, vValue).rgb : color * float(vValue) / maxValue;
+    FragColor = vec4(base * (0.35 + 0.65 * diffuse), 1.0);
+}
\ No newline at end of file
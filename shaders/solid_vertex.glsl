@@ -0,0 +1,19 @@
+// solid_vertex.glsl
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in float aValue;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+
+out vec3 vNormal;
+flat out int vValue;
+
+void main() {
+    vNormal = aNormal;
+    vValue = int(aValue);
+    gl_Position = projection * view * vec4(aPos, 1.0);
+}
\ No newline at end of file
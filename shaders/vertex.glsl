@@ -1,11 +1,28 @@
 // vertex.glsl
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aOffset; // per instance
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform vec3 onColor;
+uniform vec3 offColor;
+uniform samplerBuffer palette; // RGB cubes: color per voxel value
+uniform bool usePalette;
+
+out vec3 vColor;
+
+#include "voxel_bits.glsl"
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    int value = voxelValue(ivec3(aOffset));
+    if (usePalette && value > 0)
+        vColor = texelFetch(palette, value).rgb;
+    else
+        vColor = mix(offColor, onColor, float(value) / float((1 << depth) - 1));
+    gl_Position = projection * view * model * vec4(aPos + aOffset, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,21 @@
+// voxel_bits.glsl, included by the shaders that read a frame's voxels
+uniform usamplerBuffer voxelBits;
+uniform ivec2 bricks; // 8x8x8 bricks along x and y
+uniform int depth;    // bit-planes per voxel
+uniform int planeWords;
+
+// Brightness of voxel p in the dense layout of Frame::word(): the planes back
+// to back, planeWords words each, and in a plane eight words per brick, one per
+// z slice, with voxel (x, y) of the slice in bit (y % 8) * 8 + x % 8. Words are
+// split into (low, high) halves.
+int voxelValue(ivec3 p) {
+    int word = (((p.z >> 3) * bricks.y + (p.y >> 3)) * bricks.x + (p.x >> 3)) * 8 + (p.z & 7);
+    int bit = ((p.y & 7) << 3) | (p.x & 7);
+    int value = 0;
+    for (int plane = 0; plane < depth; ++plane) {
+        uvec2 halves = texelFetch(voxelBits, plane * planeWords + word).xy;
+        uint part = bit < 32 ? halves.x : halves.y;
+        value |= int((part >> uint(bit & 31)) & 1u) << plane;
+    }
+    return value;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include <unordered_map>
+#include "animation.h"
+
+// Apply `change` once per distinct frame and point every handle that shared
+// those contents at the result
+template <typename Change>
+static void changeEachUnique(Timeline &frames, Change change)
+{
+    std::unordered_map<FrameId, FrameHandle, FrameIdHash> done;
+    for (auto &handle : frames)
+    {
+        FrameId original = handle.id();
+        auto it = done.find(original);
+        if (it != done.end())
+        {
+            handle = it->second;
+            continue;
+        }
+        change(handle.edit());
+        handle.intern();
+        done.emplace(original, handle);
+    }
+}
+
+void Animation::addLayer(const std::string &name, int count)
+{
+    FrameHandle blank(Frame(size, depth));
+    blank.intern();
+    Layer layer;
+    layer.name = name;
+    for (int i = 0; i < count; ++i)
+        layer.frames.push_back(blank);
+    layers.push_back(std::move(layer));
+}
+
+void Animation::resize(CubeSize newSize)
+{
+    size = newSize;
+    for (int layer = 0; layer <= (int)layers.size(); ++layer)
+        changeEachUnique(layerFrames(layer), [&](Frame &frame) { frame.resize(newSize); });
+}
+
+void Animation::setDepth(int newDepth, bool rescale)
+{
+    depth = newDepth;
+    for (int layer = 0; layer <= (int)layers.size(); ++layer)
+        changeEachUnique(layerFrames(layer), [&](Frame &frame) { frame.setDepth(newDepth, rescale); });
+}
+
+void Animation::addColor(uint32_t rgb)
+{
+    if (palette.empty())
+        palette.push_back(0); // off
+    palette.push_back(rgb);
+    int needed = depthForValues(palette.size());
+    if (needed > depth)
+        setDepth(needed, false);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_ANIMATION_H_
+#define _LEDCUBEEDITOR_ANIMATION_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame.h"
+#include "timeline.h"
+
+// How a layer combines with the frames below it
+enum BlendMode
+{
+    BLEND_OR,
+    BLEND_AND,
+    BLEND_XOR,
+    BLEND_MASK, // lit LEDs of the layer switch the LEDs below off
+};
+
+// Frames drawn over the animation's own ones. Layer frame i lands on output
+// frame i + offset; output frames it doesn't reach are left alone.
+struct Layer
+{
+    std::string name;
+    Timeline frames;
+    int offset = 0;
+    BlendMode blend = BLEND_OR;
+    bool visible = true;
+};
+
+struct Animation
+{
+    CubeSize size;
+    int depth = 1; // bits per LED, 1 for plain on/off cubes
+    // 0xRRGGBB per voxel value for RGB cubes, where voxel values are palette
+    // indices and 0 stays off. Empty for single-color cubes.
+    std::vector<uint32_t> palette;
+    Timeline frames; // the background, one per output frame
+    std::vector<Layer> layers; // bottom to top, same size and depth as the frames
+    int delay = 100; // ms per frame
+    bool loop = true;
+
+    // Layer 0 is the animation's own frames, layer i > 0 is layers[i - 1]
+    Timeline &layerFrames(int layer) { return layer ? layers[layer - 1].frames : frames; }
+    const Timeline &layerFrames(int layer) const { return layer ? layers[layer - 1].frames : frames; }
+    int layerOffset(int layer) const { return layer ? layers[layer - 1].offset : 0; }
+    // Add a layer of `count` blank frames on top
+    void addLayer(const std::string &name, int count);
+
+    void resize(CubeSize newSize);
+    void setDepth(int newDepth, bool rescale = true);
+    // Append a palette color, growing the depth when the indices need another bit
+    void addColor(uint32_t rgb);
+};
+
+#endif
\ No newline at end of file
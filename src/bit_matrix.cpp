@@ -0,0 +1,138 @@
+#include "bit_matrix.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define BIT_MATRIX_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define BIT_MATRIX_AVX2 1 // compiled for AVX2 on its own, picked at runtime
+#endif
+#endif
+
+static inline uint64_t mirrorWordX(uint64_t w)
+{
+    w = ((w >> 1) & 0x5555555555555555ull) | ((w & 0x5555555555555555ull) << 1);
+    w = ((w >> 2) & 0x3333333333333333ull) | ((w & 0x3333333333333333ull) << 2);
+    return ((w >> 4) & 0x0f0f0f0f0f0f0f0full) | ((w & 0x0f0f0f0f0f0f0f0full) << 4);
+}
+
+static inline uint64_t mirrorWordY(uint64_t w)
+{
+    w = ((w >> 8) & 0x00ff00ff00ff00ffull) | ((w & 0x00ff00ff00ff00ffull) << 8);
+    w = ((w >> 16) & 0x0000ffff0000ffffull) | ((w & 0x0000ffff0000ffffull) << 16);
+    return (w >> 32) | (w << 32);
+}
+
+// Three delta swaps exchange the 1x1, 2x2 and 4x4 off-diagonal blocks
+static inline uint64_t transposeWord(uint64_t w)
+{
+    uint64_t t;
+    t = (w ^ (w >> 7)) & 0x00aa00aa00aa00aaull;
+    w ^= t ^ (t << 7);
+    t = (w ^ (w >> 14)) & 0x0000cccc0000ccccull;
+    w ^= t ^ (t << 14);
+    t = (w ^ (w >> 28)) & 0x00000000f0f0f0f0ull;
+    return w ^ t ^ (t << 28);
+}
+
+static void applyWordOpScalar(WordOp op, uint64_t *words, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (op == WORD_MIRROR_X)
+            words[i] = mirrorWordX(words[i]);
+        else if (op == WORD_MIRROR_Y)
+            words[i] = mirrorWordY(words[i]);
+        else
+            words[i] = transposeWord(words[i]);
+    }
+}
+
+#ifdef BIT_MATRIX_SSE2
+static void applyWordOpSse2(WordOp op, uint64_t *words, size_t count)
+{
+    const __m128i m1 = _mm_set1_epi64x(0x5555555555555555ll), m2 = _mm_set1_epi64x(0x3333333333333333ll);
+    const __m128i m4 = _mm_set1_epi64x(0x0f0f0f0f0f0f0f0fll);
+    const __m128i t7 = _mm_set1_epi64x(0x00aa00aa00aa00aall), t14 = _mm_set1_epi64x(0x0000cccc0000ccccll);
+    const __m128i t28 = _mm_set1_epi64x(0x00000000f0f0f0f0ll);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(words + i));
+        if (op == WORD_MIRROR_X)
+        {
+            w = _mm_or_si128(_mm_and_si128(_mm_srli_epi64(w, 1), m1), _mm_slli_epi64(_mm_and_si128(w, m1), 1));
+            w = _mm_or_si128(_mm_and_si128(_mm_srli_epi64(w, 2), m2), _mm_slli_epi64(_mm_and_si128(w, m2), 2));
+            w = _mm_or_si128(_mm_and_si128(_mm_srli_epi64(w, 4), m4), _mm_slli_epi64(_mm_and_si128(w, m4), 4));
+        }
+        else if (op == WORD_MIRROR_Y)
+        {
+            w = _mm_or_si128(_mm_slli_epi16(w, 8), _mm_srli_epi16(w, 8));
+            w = _mm_shufflelo_epi16(w, _MM_SHUFFLE(0, 1, 2, 3));
+            w = _mm_shufflehi_epi16(w, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        else
+        {
+            __m128i t = _mm_and_si128(_mm_xor_si128(w, _mm_srli_epi64(w, 7)), t7);
+            w = _mm_xor_si128(w, _mm_xor_si128(t, _mm_slli_epi64(t, 7)));
+            t = _mm_and_si128(_mm_xor_si128(w, _mm_srli_epi64(w, 14)), t14);
+            w = _mm_xor_si128(w, _mm_xor_si128(t, _mm_slli_epi64(t, 14)));
+            t = _mm_and_si128(_mm_xor_si128(w, _mm_srli_epi64(w, 28)), t28);
+            w = _mm_xor_si128(w, _mm_xor_si128(t, _mm_slli_epi64(t, 28)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(words + i), w);
+    }
+    applyWordOpScalar(op, words + i, count - i);
+}
+#endif
+
+#ifdef BIT_MATRIX_AVX2
+__attribute__((target("avx2"))) static void applyWordOpAvx2(WordOp op, uint64_t *words, size_t count)
+{
+    const __m256i m1 = _mm256_set1_epi64x(0x5555555555555555ll), m2 = _mm256_set1_epi64x(0x3333333333333333ll);
+    const __m256i m4 = _mm256_set1_epi64x(0x0f0f0f0f0f0f0f0fll);
+    const __m256i t7 = _mm256_set1_epi64x(0x00aa00aa00aa00aall), t14 = _mm256_set1_epi64x(0x0000cccc0000ccccll);
+    const __m256i t28 = _mm256_set1_epi64x(0x00000000f0f0f0f0ll);
+    const __m256i byteReverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + i));
+        if (op == WORD_MIRROR_X)
+        {
+            w = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(w, 1), m1), _mm256_slli_epi64(_mm256_and_si256(w, m1), 1));
+            w = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(w, 2), m2), _mm256_slli_epi64(_mm256_and_si256(w, m2), 2));
+            w = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(w, 4), m4), _mm256_slli_epi64(_mm256_and_si256(w, m4), 4));
+        }
+        else if (op == WORD_MIRROR_Y)
+        {
+            w = _mm256_shuffle_epi8(w, byteReverse);
+        }
+        else
+        {
+            __m256i t = _mm256_and_si256(_mm256_xor_si256(w, _mm256_srli_epi64(w, 7)), t7);
+            w = _mm256_xor_si256(w, _mm256_xor_si256(t, _mm256_slli_epi64(t, 7)));
+            t = _mm256_and_si256(_mm256_xor_si256(w, _mm256_srli_epi64(w, 14)), t14);
+            w = _mm256_xor_si256(w, _mm256_xor_si256(t, _mm256_slli_epi64(t, 14)));
+            t = _mm256_and_si256(_mm256_xor_si256(w, _mm256_srli_epi64(w, 28)), t28);
+            w = _mm256_xor_si256(w, _mm256_xor_si256(t, _mm256_slli_epi64(t, 28)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words + i), w);
+    }
+    applyWordOpScalar(op, words + i, count - i);
+}
+#endif
+
+void applyWordOp(WordOp op, uint64_t *words, size_t count)
+{
+#ifdef BIT_MATRIX_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+        return applyWordOpAvx2(op, words, count);
+#endif
+#ifdef BIT_MATRIX_SSE2
+    applyWordOpSse2(op, words, count);
+#else
+    applyWordOpScalar(op, words, count);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_BIT_MATRIX_H_
+#define _LEDCUBEEDITOR_BIT_MATRIX_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// A brick word is an 8x8 bit matrix: byte y % 8 is a row, bit x % 8 a column.
+// Mirroring x reverses the bits of every byte, mirroring y reverses the bytes
+// and swapping x and y transposes the matrix.
+enum WordOp
+{
+    WORD_MIRROR_X,
+    WORD_MIRROR_Y,
+    WORD_TRANSPOSE,
+};
+
+// Apply `op` to every word, with SSE2 or AVX2 where the CPU has them
+void applyWordOp(WordOp op, uint64_t *words, size_t count);
+
+#endif
\ No newline at end of file
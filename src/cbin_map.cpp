@@ -0,0 +1,182 @@
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <vector>
+#include "cbin_map.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Files mapped right now, once per mapping
+static std::mutex mappedLock;
+static std::multiset<std::string> mappedPaths;
+
+static std::string pathKey(const char *path)
+{
+    std::error_code error;
+    std::filesystem::path full = std::filesystem::weakly_canonical(path, error);
+    return error ? std::string(path) : full.string();
+}
+
+bool CbinMapping::isMapped(const char *path)
+{
+    std::string key = pathKey(path);
+    std::lock_guard<std::mutex> lock(mappedLock);
+    return mappedPaths.count(key) != 0;
+}
+
+CbinMapping::~CbinMapping()
+{
+    close();
+}
+
+bool CbinMapping::fail(const std::string &why)
+{
+    close();
+    message = why;
+    return false;
+}
+
+bool CbinMapping::open(const char *path, const std::function<bool(float)> &progress)
+{
+    close();
+    message.clear();
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+    {
+        file = nullptr;
+        return fail(std::string("cannot open ") + path);
+    }
+    length = (size_t)fileSize.QuadPart;
+    if (length)
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        data = mapping ? static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (!data)
+            return fail(std::string("cannot map ") + path);
+    }
+#else
+    int fd = ::open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        if (fd >= 0)
+            ::close(fd);
+        return fail(std::string("cannot open ") + path);
+    }
+    length = (size_t)st.st_size;
+    void *mapped = length ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    ::close(fd); // the mapping keeps the file open
+    if (mapped == MAP_FAILED)
+    {
+        length = 0;
+        return fail(std::string("cannot map ") + path);
+    }
+    data = static_cast<const uint8_t *>(mapped);
+#endif
+    std::string why = parseCbinHeader(data, length, length, info, dataOffset);
+    if (!why.empty())
+        return fail(why);
+    if (info.version == CBIN_V2 && !checkRecords(progress))
+        return false;
+    contentsChanged();
+    mappedPath = pathKey(path);
+    std::lock_guard<std::mutex> lock(mappedLock);
+    mappedPaths.insert(mappedPath);
+    return true;
+}
+
+// Apply every record once, as reading the file would, and make sure the
+// keyframe index points at the keyframes' records, so decode() never meets a
+// bad record or a wrong offset
+bool CbinMapping::checkRecords(const std::function<bool(float)> &progress)
+{
+    std::vector<uint8_t> fileData(info.frameBytes());
+    uint64_t offset = dataOffset;
+    for (uint32_t i = 0; i < info.frames; ++i)
+    {
+        if (i % 4096 == 0 && progress && !progress((float)i / info.frames))
+        {
+            close();
+            message.clear();
+            return false;
+        }
+        bool key = i % info.keyInterval == 0;
+        if (key)
+        {
+            uint64_t listed;
+            std::memcpy(&listed, data + info.indexOffset + i / info.keyInterval * 8, 8);
+            if (listed != offset)
+                return fail("keyframe index does not match frame " + std::to_string(i));
+        }
+        size_t recordBytes;
+        if (offset >= info.indexOffset ||
+            !applyCbinRecord(data + offset, info.indexOffset - offset, key, fileData, recordBytes))
+            return fail("frame " + std::to_string(i) + " is corrupt");
+        offset += recordBytes;
+    }
+    return true;
+}
+
+void CbinMapping::close()
+{
+#ifdef _WIN32
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    file = mapping = nullptr;
+#else
+    if (data)
+        munmap(const_cast<uint8_t *>(data), length);
+#endif
+    data = nullptr;
+    length = 0;
+    contentsChanged();
+    if (!mappedPath.empty())
+    {
+        std::lock_guard<std::mutex> lock(mappedLock);
+        mappedPaths.erase(mappedPaths.find(mappedPath));
+        mappedPath.clear();
+    }
+}
+
+Frame CbinMapping::decode(size_t index) const
+{
+    Frame frame(info.size, info.depth);
+    if (index >= info.frames)
+        return frame;
+    if (info.version == CBIN_V1)
+    {
+        decodeCbinFrame(data + dataOffset + index * info.frameBytes(), frame);
+        return frame;
+    }
+    size_t first = index / info.keyInterval * info.keyInterval;
+    uint64_t offset;
+    std::memcpy(&offset, data + info.indexOffset + first / info.keyInterval * 8, 8);
+    std::vector<uint8_t> fileData(info.frameBytes());
+    for (size_t i = first; i <= index; ++i)
+    {
+        size_t recordBytes;
+        // Cannot fail on a file open() accepted
+        if (offset < dataOffset || offset >= info.indexOffset ||
+            !applyCbinRecord(data + offset, info.indexOffset - offset, i == first, fileData, recordBytes))
+            return frame;
+        offset += recordBytes;
+    }
+    decodeCbinFrame(fileData.data(), frame);
+    return frame;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_CBIN_MAP_H_
+#define _LEDCUBEEDITOR_CBIN_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "cbin_stream.h"
+
+// A .cbin mapped into memory whole. Frames are decoded straight from the
+// mapping when asked for, a v2 frame from its keyframe on, at most keyInterval
+// records. Opening checks the header and, for v2, walks every record and the
+// keyframe index the way CbinReader would, so a corrupt file is refused up
+// front instead of showing dark frames later. Shared through lazy
+// FrameHandles, it stays mapped until the last of them is gone.
+//
+// The file must not be truncated while mapped; writeCBIN replaces files
+// instead of rewriting them for this reason. Windows refuses to replace a
+// mapped file at all, isMapped() lets writers tell that case apart.
+class CbinMapping : public FrameSource
+{
+public:
+    CbinMapping() = default;
+    CbinMapping(const CbinMapping &) = delete;
+    CbinMapping &operator=(const CbinMapping &) = delete;
+    ~CbinMapping();
+
+    // `progress` is told the share of the records checked; when it returns
+    // false open() gives up and error() stays empty
+    bool open(const char *path, const std::function<bool(float)> &progress = nullptr);
+    void close();
+    const CbinHeader &header() const { return info; }
+    const std::string &error() const { return message; }
+    Frame decode(size_t index) const override;
+
+    // Whether some open mapping reads from this file
+    static bool isMapped(const char *path);
+
+private:
+    bool fail(const std::string &why);
+    bool checkRecords(const std::function<bool(float)> &progress);
+
+    const uint8_t *data = nullptr;
+    size_t length = 0;
+    size_t dataOffset = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+    CbinHeader info;
+    std::string message;
+    std::string mappedPath; // as listed for isMapped()
+};
+
+#endif
\ No newline at end of file
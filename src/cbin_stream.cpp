@@ -0,0 +1,529 @@
+#include <algorithm>
+#include <cstring>
+#include "bit_matrix.h"
+#include "cbin_stream.h"
+
+// 8x8x8 on/off animations keep the original 9-byte header (frame count,
+// delay, loop) so existing firmware can read them. Anything else is prefixed
+// with this magic, a version, a flags byte and three uint16 dimensions.
+// Version 2 always has the magic and adds a uint16 keyframe interval and the
+// uint64 offset of the keyframe index after the loop flag. Every frame is a
+// record: a uint8 encoding, a uint32 payload length and the payload.
+static const char CBIN_MAGIC[4] = {'C', 'B', 'I', 'N'};
+// Flag: a uint8 bit depth follows the dimensions and every frame is stored as
+// that many bit-planes, least significant first
+constexpr uint8_t CBIN_FLAG_DEPTH = 0x01;
+// Flag, RGB cubes: after the depth, a uint16 color count and that many RGB
+// triples. Voxel values are indices into this palette.
+constexpr uint8_t CBIN_FLAG_PALETTE = 0x02;
+
+// v2 record encodings. Packed payloads use byte runs: a control byte c < 128
+// is followed by c + 1 literal bytes, c >= 128 by one byte repeated c - 125
+// times.
+constexpr uint8_t CBIN_FRAME_RAW = 0;
+constexpr uint8_t CBIN_FRAME_RLE = 1;
+constexpr uint8_t CBIN_FRAME_XOR = 2; // packed XOR with the previous frame, never on keyframes
+
+static bool legacyLayout(const CbinHeader &header)
+{
+    return header.version == CBIN_V1 && header.size == CubeSize() && header.depth == 1 && header.palette.empty();
+}
+
+CbinHeader cbinHeader(const Animation &animation)
+{
+    CbinHeader header;
+    header.size = animation.size;
+    header.depth = animation.depth;
+    header.palette = animation.palette;
+    header.frames = (uint32_t)animation.frames.size();
+    header.delay = animation.delay;
+    header.loop = animation.loop;
+    return header;
+}
+
+// A brick word mirrored in y and transposed has one byte per x column, its
+// bits the file bits of y + 7 down to y. Those land in a file row at column
+// `base` = size.y - 8 - y, straddling two bytes unless the height is a
+// multiple of 8; bits below column 0 are the brick's padding.
+void encodeCbinFrame(const Frame &frame, uint8_t *data)
+{
+    const CubeSize &size = frame.size;
+    size_t bytesPerRow = cbinRowBytes(size);
+    size_t layerBytes = size.z * bytesPerRow, planeBytes = size.x * layerBytes;
+    std::memset(data, 0, planeBytes * frame.depth);
+    int bricksX = Frame::bricks(size.x), bricksY = Frame::bricks(size.y);
+    size_t words = frame.brickWords();
+    uint64_t rows[8 * MAX_VOXEL_DEPTH];
+    for (size_t b = frame.nextBrick(0); b < frame.brickCount(); b = frame.nextBrick(b + 1))
+    {
+        std::copy_n(frame.brickData(b), words, rows);
+        applyWordOp(WORD_MIRROR_Y, rows, words);
+        applyWordOp(WORD_TRANSPOSE, rows, words);
+        int bx = (int)(b % bricksX) * 8, by = (int)(b / bricksX % bricksY) * 8, bz = (int)(b / bricksX / bricksY) * 8;
+        int base = size.y - 8 - by, columns = std::min(8, size.x - bx), slices = std::min(8, size.z - bz);
+        for (int plane = 0; plane < frame.depth; ++plane)
+            for (int lz = 0; lz < slices; ++lz)
+            {
+                uint64_t word = rows[plane * 8 + lz];
+                uint8_t *row = data + plane * planeBytes + bx * layerBytes + (size.z - 1 - bz - lz) * bytesPerRow;
+                for (int lx = 0; word && lx < columns; ++lx, word >>= 8, row += layerBytes)
+                {
+                    unsigned bits = (unsigned)word & 0xff;
+                    if (base < 0)
+                    {
+                        row[0] |= (uint8_t)(bits >> -base);
+                        continue;
+                    }
+                    unsigned window = bits << (base & 7);
+                    row[base >> 3] |= (uint8_t)window;
+                    if (window >> 8)
+                        row[(base >> 3) + 1] |= (uint8_t)(window >> 8);
+                }
+            }
+    }
+}
+
+void decodeCbinFrame(const uint8_t *data, Frame &frame)
+{
+    const CubeSize &size = frame.size;
+    size_t bytesPerRow = cbinRowBytes(size);
+    size_t layerBytes = size.z * bytesPerRow, planeBytes = size.x * layerBytes;
+    int bricksX = Frame::bricks(size.x), bricksY = Frame::bricks(size.y);
+    size_t words = frame.brickWords();
+    uint64_t rows[8 * MAX_VOXEL_DEPTH];
+    for (size_t b = 0; b < frame.brickCount(); ++b)
+    {
+        int bx = (int)(b % bricksX) * 8, by = (int)(b / bricksX % bricksY) * 8, bz = (int)(b / bricksX / bricksY) * 8;
+        int base = size.y - 8 - by, columns = std::min(8, size.x - bx), slices = std::min(8, size.z - bz);
+        bool straddles = base >= 0 && (base & 7) && (size_t)(base >> 3) + 1 < bytesPerRow;
+        uint64_t lit = 0;
+        for (int plane = 0; plane < frame.depth; ++plane)
+            for (int lz = 0; lz < 8; ++lz)
+            {
+                uint64_t word = 0;
+                const uint8_t *row = data + plane * planeBytes + bx * layerBytes + (size.z - 1 - bz - std::min(lz, slices - 1)) * bytesPerRow;
+                for (int lx = 0; lz < slices && lx < columns; ++lx, row += layerBytes)
+                {
+                    unsigned bits;
+                    if (base < 0)
+                        bits = row[0] << -base;
+                    else
+                        bits = (row[base >> 3] | (straddles ? row[(base >> 3) + 1] << 8 : 0)) >> (base & 7);
+                    word |= (uint64_t)(bits & 0xff) << (lx * 8);
+                }
+                rows[plane * 8 + lz] = word;
+                lit |= word;
+            }
+        if (!lit)
+            continue;
+        applyWordOp(WORD_TRANSPOSE, rows, words);
+        applyWordOp(WORD_MIRROR_Y, rows, words);
+        std::copy_n(rows, words, frame.editBrick(b));
+    }
+}
+
+void encodeCbinFrameReference(const Frame &frame, uint8_t *data)
+{
+    const CubeSize &size = frame.size;
+    int bytesPerRow = cbinRowBytes(size);
+    for (int plane = 0; plane < frame.depth; ++plane)
+        for (int x = 0; x < size.x; ++x)
+            for (int z = size.z - 1; z >= 0; --z)
+                for (int b = 0; b < bytesPerRow; ++b)
+                {
+                    uint8_t byte = 0;
+                    for (int bit = 0; bit < 8 && b * 8 + bit < size.y; ++bit)
+                        byte |= frame.planeBit(plane, x, size.y - 1 - (b * 8 + bit), z) ? (1 << bit) : 0;
+                    *data++ = byte;
+                }
+}
+
+void decodeCbinFrameReference(const uint8_t *data, Frame &frame)
+{
+    const CubeSize &size = frame.size;
+    int bytesPerRow = cbinRowBytes(size);
+    for (int plane = 0; plane < frame.depth; ++plane)
+        for (int x = 0; x < size.x; ++x)
+            for (int z = size.z - 1; z >= 0; --z)
+                for (int b = 0; b < bytesPerRow; ++b)
+                {
+                    uint8_t byte = *data++;
+                    for (int bit = 0; bit < 8 && b * 8 + bit < size.y; ++bit)
+                        frame.setPlaneBit(plane, x, size.y - 1 - (b * 8 + bit), z, (byte >> bit) & 1);
+                }
+}
+
+// Pack `length` bytes into `out`, giving up (returning 0) past `limit` bytes
+static size_t rlePack(const uint8_t *in, size_t length, uint8_t *out, size_t limit)
+{
+    size_t i = 0, o = 0;
+    while (i < length)
+    {
+        size_t run = 1;
+        while (i + run < length && run < 130 && in[i + run] == in[i])
+            ++run;
+        if (run >= 3)
+        {
+            if (o + 2 > limit)
+                return 0;
+            out[o++] = (uint8_t)(125 + run);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        // Literals up to the next run of three
+        size_t start = i;
+        while (i < length && i - start < 128 && !(i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2]))
+            ++i;
+        size_t count = i - start;
+        if (o + 1 + count > limit)
+            return 0;
+        out[o++] = (uint8_t)(count - 1);
+        std::memcpy(out + o, in + start, count);
+        o += count;
+    }
+    return o;
+}
+
+// Unpack into exactly `length` bytes, XORed into `out` or copied over it
+static bool rleUnpack(const uint8_t *in, size_t packedLength, uint8_t *out, size_t length, bool xorInto)
+{
+    size_t i = 0, o = 0;
+    while (i < packedLength)
+    {
+        uint8_t control = in[i++];
+        size_t count = control < 128 ? control + 1 : control - 125;
+        if (o + count > length || i + (control < 128 ? count : 1) > packedLength)
+            return false;
+        for (size_t k = 0; k < count; ++k)
+        {
+            uint8_t byte = control < 128 ? in[i + k] : in[i];
+            out[o + k] = xorInto ? out[o + k] ^ byte : byte;
+        }
+        i += control < 128 ? count : 1;
+        o += count;
+    }
+    return o == length;
+}
+
+bool applyCbinRecord(const uint8_t *record, size_t available, bool key, std::vector<uint8_t> &frame,
+                     size_t &recordBytes)
+{
+    if (available < CBIN_RECORD_HEADER)
+        return false;
+    uint8_t encoding = record[0];
+    uint32_t length;
+    std::memcpy(&length, record + 1, 4);
+    // Packed payloads are only stored when smaller than the raw frame
+    if (length > frame.size() || length > available - CBIN_RECORD_HEADER)
+        return false;
+    recordBytes = CBIN_RECORD_HEADER + length;
+    const uint8_t *payload = record + CBIN_RECORD_HEADER;
+    switch (encoding)
+    {
+    case CBIN_FRAME_RAW:
+        if (length != frame.size())
+            return false;
+        std::memcpy(frame.data(), payload, length);
+        return true;
+    case CBIN_FRAME_RLE:
+        return rleUnpack(payload, length, frame.data(), frame.size(), false);
+    case CBIN_FRAME_XOR:
+        return !key && rleUnpack(payload, length, frame.data(), frame.size(), true);
+    }
+    return false;
+}
+
+std::string parseCbinHeader(const uint8_t *data, size_t length, uint64_t fileSize, CbinHeader &header, size_t &dataOffset)
+{
+    size_t at = 0;
+    auto take = [&](void *value, size_t bytes)
+    {
+        if (at + bytes > length)
+            return false;
+        std::memcpy(value, data + at, bytes);
+        at += bytes;
+        return true;
+    };
+    const std::string tooShort = "file too short for a header";
+    header = CbinHeader();
+    char magic[4] = {};
+    uint32_t numFrames = 0;
+    if (!take(magic, 4))
+        return tooShort;
+    if (std::memcmp(magic, CBIN_MAGIC, 4) == 0)
+    {
+        uint8_t version = 0, flags = 0, depth = 1;
+        uint16_t dims[3] = {};
+        if (!take(&version, 1) || !take(&flags, 1) || !take(dims, sizeof(dims)))
+            return tooShort;
+        if (version != CBIN_V1 && version != CBIN_V2)
+            return "unsupported version " + std::to_string(version);
+        header.version = version;
+        if (flags & ~(CBIN_FLAG_DEPTH | CBIN_FLAG_PALETTE))
+            return "unknown flags";
+        header.size = CubeSize{dims[0], dims[1], dims[2]};
+        if (!header.size.valid())
+            return "unsupported cube size";
+        if ((flags & CBIN_FLAG_DEPTH) && !take(&depth, 1))
+            return tooShort;
+        if (depth < 1 || depth > MAX_VOXEL_DEPTH)
+            return "unsupported bit depth " + std::to_string(depth);
+        header.depth = depth;
+        if (flags & CBIN_FLAG_PALETTE)
+        {
+            uint16_t colors = 0;
+            if (!take(&colors, 2))
+                return tooShort;
+            if (colors > (1u << depth))
+                return "palette larger than the bit depth can index";
+            for (int i = 0; i < colors; ++i)
+            {
+                uint8_t rgb[3];
+                if (!take(rgb, 3))
+                    return tooShort;
+                header.palette.push_back((uint32_t)rgb[0] << 16 | (uint32_t)rgb[1] << 8 | rgb[2]);
+            }
+        }
+        if (!take(&numFrames, 4))
+            return tooShort;
+    }
+    else
+    {
+        std::memcpy(&numFrames, magic, 4);
+    }
+    uint8_t loop = 0;
+    if (!take(&header.delay, 4) || !take(&loop, 1))
+        return tooShort;
+    header.loop = loop != 0;
+    header.frames = numFrames;
+    if (header.version == CBIN_V2)
+    {
+        uint16_t interval = 0;
+        if (!take(&interval, 2) || !take(&header.indexOffset, 8))
+            return tooShort;
+        if (interval == 0)
+            return "keyframe interval of 0";
+        header.keyInterval = interval;
+    }
+    dataOffset = at;
+
+    // Trust the frame count only as far as the file backs it up
+    uint64_t available = fileSize - at;
+    if (header.version == CBIN_V2)
+    {
+        uint64_t keys = ((uint64_t)numFrames + header.keyInterval - 1) / header.keyInterval;
+        if (header.indexOffset < at || header.indexOffset > fileSize || keys * 8 > fileSize - header.indexOffset)
+            return "keyframe index missing, the file may not have been finished";
+        if ((uint64_t)numFrames * CBIN_RECORD_HEADER > header.indexOffset - at)
+            return "header announces " + std::to_string(numFrames) + " frames, the file holds at most " +
+                   std::to_string((header.indexOffset - at) / CBIN_RECORD_HEADER);
+    }
+    else if ((uint64_t)numFrames * header.frameBytes() > available)
+        return "header announces " + std::to_string(numFrames) + " frames, the file holds " +
+               std::to_string(available / header.frameBytes());
+    return std::string();
+}
+
+bool CbinReader::fail(const std::string &why)
+{
+    message = why;
+    in.close();
+    return false;
+}
+
+bool CbinReader::open(const char *path)
+{
+    index = 0;
+    message.clear();
+    in.close();
+    in.clear();
+    in.open(path, std::ios::binary);
+    if (!in)
+        return fail(std::string("cannot open ") + path);
+    in.seekg(0, std::ios::end);
+    uint64_t fileSize = (uint64_t)in.tellg();
+    in.seekg(0);
+
+    buffer.resize(CBIN_MAX_HEADER);
+    in.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+    size_t dataOffset = 0;
+    std::string why = parseCbinHeader(buffer.data(), (size_t)in.gcount(), fileSize, info, dataOffset);
+    if (!why.empty())
+        return fail(why);
+    in.clear();
+    in.seekg(dataOffset);
+    buffer.resize(info.frameBytes());
+    current = Frame(info.size, info.depth);
+    return true;
+}
+
+bool CbinReader::next(Frame &frame)
+{
+    if (!in.is_open() || index >= info.frames)
+        return false;
+    if (info.version == CBIN_V2)
+    {
+        // The payload length is checked before the record is read whole
+        record.resize(CBIN_RECORD_HEADER);
+        in.read(reinterpret_cast<char *>(record.data()), CBIN_RECORD_HEADER);
+        bool ok = in.gcount() == (std::streamsize)CBIN_RECORD_HEADER;
+        uint32_t length = 0;
+        std::memcpy(&length, record.data() + 1, 4);
+        ok = ok && length <= buffer.size();
+        if (ok)
+        {
+            record.resize(CBIN_RECORD_HEADER + length);
+            in.read(reinterpret_cast<char *>(record.data()) + CBIN_RECORD_HEADER, length);
+            ok = in.gcount() == (std::streamsize)length;
+        }
+        size_t recordBytes;
+        if (!ok || !applyCbinRecord(record.data(), record.size(), index % info.keyInterval == 0, buffer, recordBytes))
+            return fail("frame " + std::to_string(index) + " is corrupt");
+    }
+    else
+    {
+        in.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+        if (in.gcount() != (std::streamsize)buffer.size())
+            return fail("frame " + std::to_string(index) + " is cut short");
+    }
+    if (frame.size != info.size || frame.depth != info.depth)
+        frame = Frame(info.size, info.depth);
+    else
+        frame.clear();
+    decodeCbinFrame(buffer.data(), frame);
+    ++index;
+    return true;
+}
+
+bool CbinWriter::fail(const std::string &why)
+{
+    message = why;
+    out.close();
+    return false;
+}
+
+bool CbinWriter::open(const char *path, const CbinHeader &header)
+{
+    info = header;
+    written = 0;
+    message.clear();
+    out.close();
+    out.clear();
+    out.open(path, std::ios::binary);
+    if (!out)
+        return fail(std::string("cannot open ") + path + " for writing");
+    if (!legacyLayout(info))
+    {
+        const CubeSize &size = info.size;
+        uint16_t dims[3] = {(uint16_t)size.x, (uint16_t)size.y, (uint16_t)size.z};
+        uint8_t flags = 0;
+        if (info.depth != 1 || !info.palette.empty())
+            flags |= CBIN_FLAG_DEPTH;
+        if (!info.palette.empty())
+            flags |= CBIN_FLAG_PALETTE;
+        out.write(CBIN_MAGIC, 4);
+        out.put((char)info.version);
+        out.put(flags);
+        out.write(reinterpret_cast<const char *>(dims), sizeof(dims));
+        if (flags & CBIN_FLAG_DEPTH)
+            out.put((char)info.depth);
+        if (flags & CBIN_FLAG_PALETTE)
+        {
+            uint16_t colors = (uint16_t)info.palette.size();
+            out.write(reinterpret_cast<const char *>(&colors), 2);
+            for (uint32_t rgb : info.palette)
+            {
+                out.put((char)(rgb >> 16));
+                out.put((char)(rgb >> 8));
+                out.put((char)rgb);
+            }
+        }
+    }
+    countAt = out.tellp();
+    out.write(reinterpret_cast<const char *>(&info.frames), 4);
+    out.write(reinterpret_cast<const char *>(&info.delay), 4);
+    out.put(info.loop ? 1 : 0);
+    if (info.version == CBIN_V2)
+    {
+        uint16_t interval = (uint16_t)info.keyInterval;
+        uint64_t indexOffset = 0; // 0 until close(), which marks unfinished files
+        out.write(reinterpret_cast<const char *>(&interval), 2);
+        indexAt = out.tellp();
+        out.write(reinterpret_cast<const char *>(&indexOffset), 8);
+        previous.assign(info.frameBytes(), 0);
+        packed.resize(info.frameBytes());
+        packedDelta.resize(info.frameBytes());
+        keyOffsets.clear();
+    }
+    buffer.resize(info.frameBytes());
+    return out.good() || fail("write error");
+}
+
+bool CbinWriter::write(const Frame &frame)
+{
+    if (!out.is_open())
+        return false;
+    if (frame.size != info.size || frame.depth != info.depth)
+        return fail("frame " + std::to_string(written) + " does not match the header's size or depth");
+    encodeCbinFrame(frame, buffer.data());
+    if (info.version == CBIN_V2)
+        writeRecord();
+    else
+        out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    ++written;
+    return out.good() || fail("write error");
+}
+
+// Store the frame in `buffer` in whichever encoding comes out smallest
+void CbinWriter::writeRecord()
+{
+    bool key = written % info.keyInterval == 0;
+    if (key)
+        keyOffsets.push_back((uint64_t)out.tellp());
+    size_t frameBytes = buffer.size();
+    uint8_t encoding = CBIN_FRAME_RAW;
+    const uint8_t *payload = buffer.data();
+    uint32_t length = (uint32_t)frameBytes;
+    if (size_t bytes = rlePack(buffer.data(), frameBytes, packed.data(), length - 1))
+    {
+        encoding = CBIN_FRAME_RLE;
+        payload = packed.data();
+        length = (uint32_t)bytes;
+    }
+    if (!key)
+    {
+        for (size_t i = 0; i < frameBytes; ++i)
+            previous[i] ^= buffer[i];
+        if (size_t bytes = rlePack(previous.data(), frameBytes, packedDelta.data(), length - 1))
+        {
+            encoding = CBIN_FRAME_XOR;
+            payload = packedDelta.data();
+            length = (uint32_t)bytes;
+        }
+    }
+    out.put((char)encoding);
+    out.write(reinterpret_cast<const char *>(&length), 4);
+    out.write(reinterpret_cast<const char *>(payload), length);
+    std::copy(buffer.begin(), buffer.end(), previous.begin());
+}
+
+bool CbinWriter::close()
+{
+    if (!out.is_open())
+        return false;
+    if (info.version == CBIN_V2)
+    {
+        uint64_t indexOffset = (uint64_t)out.tellp();
+        out.write(reinterpret_cast<const char *>(keyOffsets.data()), keyOffsets.size() * 8);
+        out.seekp(indexAt);
+        out.write(reinterpret_cast<const char *>(&indexOffset), 8);
+    }
+    if (written != info.frames)
+    {
+        out.seekp(countAt);
+        out.write(reinterpret_cast<const char *>(&written), 4);
+    }
+    out.close();
+    return !out.fail() || fail("write error");
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_CBIN_STREAM_H_
+#define _LEDCUBEEDITOR_CBIN_STREAM_H_
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "animation.h"
+
+// Every plane of a frame is stored as x layers, each as z rows from the top,
+// each row holding the y columns from the far side packed LSB first into bytes
+inline int cbinRowBytes(const CubeSize &size)
+{
+    return (size.y + 7) / 8;
+}
+
+// v1 stores every frame as is. v2 stores each frame raw, run-length packed or
+// as a packed XOR delta from the frame before, whichever is smallest, and ends
+// with an index of keyframes, frames that never use a delta.
+constexpr int CBIN_V1 = 1;
+constexpr int CBIN_V2 = 2;
+constexpr int CBIN_KEY_INTERVAL = 32;
+
+struct CbinHeader
+{
+    int version = CBIN_V1;
+    CubeSize size; // files without the magic are 8x8x8 on/off
+    int depth = 1;
+    std::vector<uint32_t> palette;
+    uint32_t frames = 0;
+    int32_t delay = 100;
+    bool loop = true;
+    // v2: frames i * keyInterval are keyframes, listed as uint64 file offsets
+    // at indexOffset
+    int keyInterval = CBIN_KEY_INTERVAL;
+    uint64_t indexOffset = 0;
+
+    size_t frameBytes() const { return (size_t)depth * size.x * size.z * cbinRowBytes(size); }
+};
+
+CbinHeader cbinHeader(const Animation &animation);
+
+// Longest header a .cbin can have: a v2 header with a full palette
+constexpr size_t CBIN_MAX_HEADER = 4 + 1 + 1 + 6 + 1 + 2 + 3 * MAX_PALETTE_SIZE + 4 + 4 + 1 + 2 + 8;
+// Size of a v2 frame record before its payload: encoding and payload length
+constexpr size_t CBIN_RECORD_HEADER = 5;
+
+// Parse the header from the first `length` bytes of a file of `fileSize`
+// bytes and set `dataOffset` to where the frames start. Returns why the header
+// is unusable, empty when it is fine.
+std::string parseCbinHeader(const uint8_t *data, size_t length, uint64_t fileSize, CbinHeader &header,
+                            size_t &dataOffset);
+// Convert between a frame and its file data, eight y columns of eight x
+// columns at a time through bit-matrix transposes of the brick words. Decoding
+// wants a cleared frame of the header's size and depth.
+void encodeCbinFrame(const Frame &frame, uint8_t *data);
+void decodeCbinFrame(const uint8_t *data, Frame &frame);
+// The same one bit at a time, what the fast versions are checked against
+void encodeCbinFrameReference(const Frame &frame, uint8_t *data);
+void decodeCbinFrameReference(const uint8_t *data, Frame &frame);
+// Apply the v2 frame record at `record`, with `available` bytes of file left,
+// to `frame`, which holds the file data of the frame before. Sets
+// `recordBytes` to the record's length; false when the record is corrupt.
+bool applyCbinRecord(const uint8_t *record, size_t available, bool key, std::vector<uint8_t> &frame,
+                     size_t &recordBytes);
+
+// Reads a .cbin one frame at a time, so memory stays at one frame whatever the
+// file holds. open() checks the header, including that the file is long
+// enough for the frames it announces; frames are read a whole frame per call.
+//
+//     CbinReader reader;
+//     if (reader.open(path))
+//         for (const Frame &frame : reader)
+//             ...
+//     if (!reader.error().empty())
+//         ...
+class CbinReader
+{
+public:
+    bool open(const char *path);
+    const CbinHeader &header() const { return info; }
+    // Why open() or next() failed, empty otherwise
+    const std::string &error() const { return message; }
+    uint32_t framesRead() const { return index; }
+    // Decode the next frame into `frame`, false at the end or on a read error
+    bool next(Frame &frame);
+
+    class Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Frame;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Frame *;
+        using reference = const Frame &;
+
+        explicit Iterator(CbinReader *reader = nullptr) : reader(reader) {}
+        const Frame &operator*() const { return reader->current; }
+        const Frame *operator->() const { return &reader->current; }
+        Iterator &operator++()
+        {
+            if (!reader->next(reader->current))
+                reader = nullptr;
+            return *this;
+        }
+        bool operator==(const Iterator &other) const { return reader == other.reader; }
+        bool operator!=(const Iterator &other) const { return reader != other.reader; }
+
+    private:
+        CbinReader *reader;
+    };
+    Iterator begin() { return ++Iterator(this); }
+    Iterator end() { return Iterator(); }
+
+private:
+    bool fail(const std::string &why);
+
+    std::ifstream in;
+    CbinHeader info;
+    std::vector<uint8_t> buffer; // one frame of file data
+    std::vector<uint8_t> record; // v2 frame record being read
+    Frame current;
+    uint32_t index = 0;
+    std::string message;
+};
+
+// Writes a .cbin a frame at a time, in the header's version. The frame count
+// in the header is patched to the number of frames written when the file is
+// closed, which also writes the v2 keyframe index.
+class CbinWriter
+{
+public:
+    bool open(const char *path, const CbinHeader &header);
+    // Frames must have the header's size and depth
+    bool write(const Frame &frame);
+    bool close();
+    const std::string &error() const { return message; }
+
+private:
+    bool fail(const std::string &why);
+    void writeRecord();
+
+    std::ofstream out;
+    CbinHeader info;
+    std::streamoff countAt = 0;
+    std::streamoff indexAt = 0;
+    std::vector<uint8_t> buffer, previous, packed, packedDelta;
+    std::vector<uint64_t> keyOffsets;
+    uint32_t written = 0;
+    std::string message;
+};
+
+#endif
\ No newline at end of file
@@ -1,11 +1,31 @@
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <memory>
 #include <tinyfiledialogs.h>
 #include <iostream>
 #include "main.h"
+#include "cbin_map.h"
+#include "cbin_stream.h"
+
+// Bit-angle-modulation stream for PWM firmware: per frame, per x layer, per
+// color channel, the layer's bit-planes from least significant up. Plane b is
+// shown for 2^b ticks, so the refresh loop only shifts rows out and never
+// compares values. Single-color cubes have one channel of `depth` planes, RGB
+// cubes three channels of 8 planes expanded from the palette.
+static const char BAM_MAGIC[4] = {'C', 'B', 'A', 'M'};
+constexpr uint8_t BAM_VERSION = 1;
+
+// Report `done` of `total` steps, false when the caller asked to stop
+static bool keepGoing(const FileProgress &progress, size_t done, size_t total)
+{
+    return !progress || progress(total ? (float)done / total : 1.0f);
+}
 
 // Export frames to .cbin
-void exportCBIN(std::vector<Frame> &frames, int delay, bool loop)
+bool exportCBIN(const Animation &animation, int version, const FileProgress &progress)
 {
     const char *filter_patterns[] = {"*.cbin"};
     const char *file = tinyfd_saveFileDialog(
@@ -22,32 +42,142 @@ void exportCBIN(std::vector<Frame> &frames, int delay, bool loop)
     else
     {
         std::cout << "No file selected." << std::endl;
-        return;
+        return false;
+    }
+    return writeCBIN(file, animation, version, progress);
+}
+
+bool writeCBIN(const char *path, const Animation &animation, int version, const FileProgress &progress)
+{
+#ifdef _WIN32
+    // Windows cannot rename over a mapped file; say so before doing the work
+    if (CbinMapping::isMapped(path))
+    {
+        std::cerr << "Cannot write " << path << ": frames imported from it are still read from the file. "
+                  << "Save under another name, or import another file first." << std::endl;
+        return false;
+    }
+#endif
+    // Written next to the target and renamed over it, so a mapped file that
+    // lazy frames still read from is never rewritten in place
+    std::string partial = std::string(path) + ".part";
+    CbinHeader header = cbinHeader(animation);
+    header.version = version;
+    CbinWriter writer;
+    bool ok = writer.open(partial.c_str(), header), cancelled = false;
+    size_t done = 0;
+    for (const auto &handle : animation.frames)
+    {
+        if (!ok || (cancelled = !keepGoing(progress, done++, header.frames)))
+            break;
+        ok = handle.loaded() ? writer.write(*handle) : writer.write(handle.decode());
     }
-    std::ofstream out(file, std::ios::binary);
-    uint32_t numFrames = frames.size();
+    ok = ok && !cancelled && writer.close();
+    std::error_code error;
+    if (ok)
+        std::filesystem::rename(partial, path, error);
+    if (!ok || error)
+    {
+        if (cancelled)
+            std::cout << "Export of " << path << " cancelled." << std::endl;
+        else
+            std::cerr << "Cannot write " << path << ": " << (ok ? error.message() : writer.error()) << "." << std::endl;
+        writer.close();
+        std::filesystem::remove(partial, error);
+        return false;
+    }
+    return true;
+}
+
+bool exportBAM(const Animation &animation, const FileProgress &progress)
+{
+    const char *filter_patterns[] = {"*.bam"};
+    const char *file = tinyfd_saveFileDialog(
+        "Choose a file",
+        "Cube.bam",
+        1,
+        filter_patterns,
+        "bit-angle-modulation streams");
+
+    if (file)
+    {
+        std::cout << "You selected: " << file << std::endl;
+    }
+    else
+    {
+        std::cout << "No file selected." << std::endl;
+        return false;
+    }
+    return writeBAM(file, animation, progress);
+}
+
+bool writeBAM(const char *path, const Animation &animation, const FileProgress &progress)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Cannot open " << path << " for writing." << std::endl;
+        return false;
+    }
+    const CubeSize &size = animation.size;
+    const std::vector<uint32_t> &palette = animation.palette;
+    int channelCount = palette.empty() ? 1 : 3;
+    int depth = palette.empty() ? animation.depth : 8;
+    uint16_t dims[3] = {(uint16_t)size.x, (uint16_t)size.y, (uint16_t)size.z};
+    uint32_t numFrames = animation.frames.size();
+    out.write(BAM_MAGIC, 4);
+    out.put(BAM_VERSION);
+    out.put((char)depth);
+    out.put((char)channelCount);
+    out.write(reinterpret_cast<const char *>(dims), sizeof(dims));
     out.write(reinterpret_cast<const char *>(&numFrames), 4);
-    out.write(reinterpret_cast<const char *>(&delay), 4);
-    out.put(loop ? 1 : 0);
-    for (const auto &frame : frames)
+    out.write(reinterpret_cast<const char *>(&animation.delay), 4);
+    out.put(animation.loop ? 1 : 0);
+    std::vector<Frame> channels(3, Frame(size, 8));
+    // Rows come from the .cbin encoding of each channel, only reordered
+    size_t layerBytes = size.z * cbinRowBytes(size), planeBytes = size.x * layerBytes;
+    std::vector<uint8_t> encoded(channelCount * depth * planeBytes);
+    size_t done = 0;
+    for (const auto &handle : animation.frames)
     {
-        for (int z = 0; z < CUBE_SIZE; z++)
+        if (!keepGoing(progress, done++, numFrames))
+        {
+            // A partial stream is of no use to the firmware
+            out.close();
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            std::cout << "Export of " << path << " cancelled." << std::endl;
+            return false;
+        }
+        const Frame &frame = *handle;
+        const Frame *sources = &frame;
+        if (!palette.empty())
         {
-            for (int x = 0; x < CUBE_SIZE; ++x)
-            {
-                uint8_t byte = 0;
-                for (int y = 0; y < CUBE_SIZE; ++y)
-                {
-                    byte |= frame.voxels[CUBE_SIZE - x - 1][CUBE_SIZE - 1 - y][z] ? (1 << y) : 0;
-                }
-                out.put(byte);
-            }
+            // Expand the palette indices into red, green and blue brightness
+            for (int z = 0; z < size.z; ++z)
+                for (int y = 0; y < size.y; ++y)
+                    for (int x = 0; x < size.x; ++x)
+                    {
+                        int index = frame.value(x, y, z);
+                        uint32_t rgb = index < (int)palette.size() ? palette[index] : 0;
+                        for (int c = 0; c < 3; ++c)
+                            channels[c].setValue(x, y, z, (rgb >> (16 - 8 * c)) & 0xff);
+                    }
+            sources = channels.data();
         }
+        for (int c = 0; c < channelCount; ++c)
+            encodeCbinFrame(sources[c], &encoded[c * depth * planeBytes]);
+        for (int x = 0; x < size.x; ++x)
+            for (int c = 0; c < channelCount; ++c)
+                for (int plane = 0; plane < depth; ++plane)
+                    out.write(reinterpret_cast<const char *>(&encoded[(c * depth + plane) * planeBytes + x * layerBytes]),
+                              layerBytes);
     }
     out.close();
+    return !out.fail();
 }
 
-void importCBIN(std::vector<Frame> &frames, int &delay, bool &loop)
+bool importCBIN(Animation &animation, const FileProgress &progress)
 {
     const char *filter_patterns[] = {"*.cbin"};
     const char *file = tinyfd_openFileDialog(
@@ -65,33 +195,50 @@ void importCBIN(std::vector<Frame> &frames, int &delay, bool &loop)
     else
     {
         std::cout << "No file selected." << std::endl;
-        return;
+        return false;
+    }
+    return mapCBIN(file, animation, progress);
+}
+
+bool mapCBIN(const char *path, Animation &animation, const FileProgress &progress)
+{
+    // Checking the records of a v2 file is most of the work
+    auto mapping = std::make_shared<CbinMapping>();
+    bool opened = mapping->open(path, [&](float done) { return !progress || progress(done * 0.9f); });
+    if (!opened && mapping->error().empty())
+    {
+        std::cout << "Import of " << path << " cancelled." << std::endl;
+        return false;
     }
-    std::ifstream in(file, std::ios::binary);
-    uint32_t numFrames;
-    in.read(reinterpret_cast<char *>(&numFrames), 4);
-    in.read(reinterpret_cast<char *>(&delay), 4);
-    in.read(reinterpret_cast<char *>(&loop),1);
-    frames.clear();
-    frames.resize(numFrames);
-    for (int i = 0; i < numFrames; ++i)
+    if (!opened)
     {
-        frames[i] = Frame();
+        std::cerr << "Cannot read " << path << ": " << mapping->error() << "." << std::endl;
+        return false;
     }
-    for (auto &frame : frames)
+    const CbinHeader &header = mapping->header();
+    std::vector<FrameHandle> frames;
+    frames.reserve(header.frames);
+    for (uint32_t i = 0; i < header.frames; ++i)
     {
-        for (int z = 0; z < CUBE_SIZE; z++)
+        if (i % 4096 == 0 && progress && !progress(0.9f + 0.1f * i / header.frames))
         {
-            for (int x = 0; x < CUBE_SIZE; ++x)
-            {
-                uint8_t byte = 0;
-                in.read(reinterpret_cast<char *>(&byte), 1);
-                for (int y = 0; y < CUBE_SIZE; ++y)
-                {
-                    frame.voxels[CUBE_SIZE - x - 1][CUBE_SIZE - 1 - y][z] = (byte & (1 << y)) ? 1 : 0;
-                }
-            }
+            std::cout << "Import of " << path << " cancelled." << std::endl;
+            return false;
         }
+        frames.push_back(FrameHandle::lazy(mapping, i));
+    }
+    if (frames.empty())
+    {
+        frames.push_back(FrameHandle(Frame(header.size, header.depth)));
+        frames.back().intern();
     }
-    in.close();
+    animation.size = header.size;
+    animation.depth = header.depth;
+    animation.palette = header.palette;
+    animation.delay = header.delay;
+    animation.loop = header.loop;
+    animation.layers.clear();
+    animation.frames.clear();
+    animation.frames.append(std::move(frames));
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include "compositor.h"
+
+// Brick by brick, touching only the bricks that can change
+static void blend(Frame &out, const Frame &layer, BlendMode mode)
+{
+    size_t words = out.brickWords(), total = out.brickCount();
+    if (mode == BLEND_AND)
+    {
+        for (size_t b = out.nextBrick(0); b < total; b = out.nextBrick(b + 1))
+        {
+            const uint64_t *over = layer.brickData(b);
+            uint64_t *brick = out.editBrick(b);
+            for (size_t i = 0; i < words; ++i)
+                brick[i] &= over ? over[i] : 0;
+        }
+        return;
+    }
+    for (size_t b = layer.nextBrick(0); b < total; b = layer.nextBrick(b + 1))
+    {
+        const uint64_t *over = layer.brickData(b);
+        if (mode == BLEND_MASK && !out.brickData(b))
+            continue;
+        uint64_t *brick = out.editBrick(b);
+        if (mode == BLEND_MASK)
+        {
+            for (int lz = 0; lz < 8; ++lz)
+            {
+                uint64_t lit = layer.litWord(b * 8 + lz);
+                for (int plane = 0; plane < out.depth; ++plane)
+                    brick[plane * 8 + lz] &= ~lit;
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < words; ++i)
+                brick[i] = mode == BLEND_OR ? brick[i] | over[i] : brick[i] ^ over[i];
+        }
+    }
+}
+
+FrameHandle compositeFrame(const Animation &animation, int index)
+{
+    const FrameHandle &base = animation.frames[index];
+    Frame out;
+    bool blended = false;
+    for (const Layer &layer : animation.layers)
+    {
+        int at = index - layer.offset;
+        if (!layer.visible || at < 0 || at >= (int)layer.frames.size())
+            continue;
+        const Frame &over = *layer.frames[at];
+        if (over.size != base->size || over.depth != base->depth)
+            continue;
+        if (!blended)
+            out = *base;
+        blended = true;
+        blend(out, over, layer.blend);
+    }
+    if (!blended)
+        return base;
+    FrameHandle result(std::move(out));
+    result.intern();
+    return result;
+}
+
+const FrameHandle &Compositor::frame(const Animation &animation, int index)
+{
+    if (animation.layers.empty())
+        return animation.frames[index];
+    if (index >= (int)cache.size())
+        cache.resize(animation.frames.size(), animation.frames[index]); // placeholders share one frame
+    if (index >= (int)valid.size())
+        valid.resize(cache.size(), 0);
+    if (!valid[index])
+    {
+        cache[index] = compositeFrame(animation, index);
+        valid[index] = 1;
+    }
+    return cache[index];
+}
+
+void Compositor::invalidate(const Animation &animation, int layer, int layerFrame)
+{
+    invalidateRange(layerFrame + animation.layerOffset(layer), 1);
+}
+
+void Compositor::invalidateRange(int first, int count)
+{
+    first = std::max(first, 0);
+    int last = std::min(first + count, (int)valid.size());
+    for (int i = first; i < last; ++i)
+        valid[i] = 0;
+}
+
+void Compositor::invalidateFrom(int first)
+{
+    size_t keep = std::min(valid.size(), (size_t)std::max(first, 0));
+    valid.resize(keep);
+    cache.erase(cache.begin() + std::min(cache.size(), keep), cache.end());
+}
+
+void Compositor::invalidateAll()
+{
+    valid.clear();
+    cache.clear();
+}
+
+size_t Compositor::cachedFrames() const
+{
+    return std::count(valid.begin(), valid.end(), 1);
+}
+
+Animation Compositor::flatten(const Animation &animation)
+{
+    Animation flat;
+    flat.size = animation.size;
+    flat.depth = animation.depth;
+    flat.palette = animation.palette;
+    flat.delay = animation.delay;
+    flat.loop = animation.loop;
+    for (size_t i = 0; i < animation.frames.size(); ++i)
+        flat.frames.push_back(frame(animation, (int)i));
+    return flat;
+}
\ No newline at end of file
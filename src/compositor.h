@@ -0,0 +1,35 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_COMPOSITOR_H_
+#define _LEDCUBEEDITOR_COMPOSITOR_H_
+
+#include <vector>
+#include "animation.h"
+
+// Combine output frame `index` of the animation with the visible layers over it
+FrameHandle compositeFrame(const Animation &animation, int index);
+
+// Output frames of an animation with layers, built on first use and kept until
+// an edit invalidates them. Frames no layer reaches are shared with the
+// animation's own frames.
+class Compositor
+{
+public:
+    const FrameHandle &frame(const Animation &animation, int index);
+    // After frame `layerFrame` of a layer (see Animation::layerFrames) changed
+    void invalidate(const Animation &animation, int layer, int layerFrame);
+    void invalidateRange(int first, int count);
+    void invalidateFrom(int first);
+    // Also lets go of the cached frames, which may be all that still keeps a
+    // replaced animation, and the file it was mapped from, alive
+    void invalidateAll();
+    size_t cachedFrames() const;
+
+    // Copy of the animation with the layers merged into its frames, for export
+    Animation flatten(const Animation &animation);
+
+private:
+    std::vector<FrameHandle> cache;
+    std::vector<char> valid;
+};
+
+#endif
\ No newline at end of file
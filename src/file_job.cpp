@@ -0,0 +1,80 @@
+#include <chrono>
+#include "file_job.h"
+#include "main.h"
+#include "perf.h"
+
+FileJob::~FileJob()
+{
+    // A worker still waiting on the file dialog keeps the exit waiting too
+    cancel();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool FileJob::start(FileJobKind jobKind, Animation animation, int formatVersion)
+{
+    if (busy())
+        return false;
+    kind = jobKind;
+    data = std::move(animation);
+    version = formatVersion;
+    succeeded = false;
+    workMs = 0.0;
+    cancelled = false;
+    choosing = true;
+    fraction = 0.0f;
+    running = true;
+    worker = std::thread(&FileJob::run, this);
+    return true;
+}
+
+void FileJob::run()
+{
+    // The clock starts once a file is chosen, time in the dialog is not the job's
+    std::chrono::steady_clock::time_point begin;
+    FileProgress progress = [this, &begin](float done)
+    {
+        if (choosing)
+            begin = std::chrono::steady_clock::now();
+        choosing = false;
+        fraction = done;
+        return !cancelled;
+    };
+    if (kind == FILE_JOB_IMPORT_CBIN)
+    {
+        Animation loaded;
+        succeeded = importCBIN(loaded, progress);
+        data = std::move(loaded);
+    }
+    else if (kind == FILE_JOB_EXPORT_CBIN)
+        succeeded = exportCBIN(data, version, progress);
+    else
+        succeeded = exportBAM(data, progress);
+    if (!choosing)
+        workMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    running = false;
+}
+
+std::string FileJob::label() const
+{
+    if (choosing)
+        return "Choosing a file...";
+    if (cancelled)
+        return "Cancelling...";
+    const char *verb = kind == FILE_JOB_IMPORT_CBIN ? "Importing" : "Exporting";
+    return verb + std::string(" ") + std::to_string((int)(fraction * 100.0f)) + "%";
+}
+
+bool FileJob::finish(Animation &animation)
+{
+    if (!busy() || running)
+        return false;
+    worker.join();
+    if (workMs > 0.0)
+        perfAddTime(kind == FILE_JOB_IMPORT_CBIN ? PERF_CPU_IMPORT : PERF_CPU_EXPORT, workMs);
+    bool imported = kind == FILE_JOB_IMPORT_CBIN && succeeded;
+    if (imported)
+        animation = std::move(data);
+    data = Animation(); // drop the export's copy of the frames
+    return imported;
+}
\ No newline at end of file
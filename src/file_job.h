@@ -0,0 +1,57 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_FILE_JOB_H_
+#define _LEDCUBEEDITOR_FILE_JOB_H_
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "animation.h"
+
+enum FileJobKind
+{
+    FILE_JOB_IMPORT_CBIN,
+    FILE_JOB_EXPORT_CBIN,
+    FILE_JOB_EXPORT_BAM,
+};
+
+// An import or export, file dialog included, run on a worker thread so the
+// editor keeps drawing. Exports work on their own copy of the animation, which
+// costs little since frames are shared; imports load into a separate one that
+// finish() hands over in one piece. One job at a time.
+class FileJob
+{
+public:
+    FileJob() = default;
+    FileJob(const FileJob &) = delete;
+    FileJob &operator=(const FileJob &) = delete;
+    ~FileJob();
+
+    // Running, or done but not collected by finish() yet
+    bool busy() const { return worker.joinable(); }
+    // Exports take the animation to write, imports ignore it
+    bool start(FileJobKind kind, Animation animation = Animation(), int version = 1);
+    void cancel() { cancelled = true; }
+    float progress() const { return fraction; }
+    // What the progress bar should say
+    std::string label() const;
+    // Collect a job that is done, adding the time it worked to the import or
+    // export series of the perf overlay. True when it imported an animation,
+    // which then replaces `animation`.
+    bool finish(Animation &animation);
+
+private:
+    void run();
+
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> choosing{false}; // the file dialog is open
+    std::atomic<float> fraction{0.0f};
+    FileJobKind kind = FILE_JOB_IMPORT_CBIN;
+    Animation data;
+    int version = 1;
+    bool succeeded = false;
+    double workMs = 0.0; // from the file being chosen to the job ending
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include "frame.h"
+
+// Call visit(x, y, z, value) for every lit LED, brick by brick
+template <typename Visit>
+static void forEachLit(const Frame &frame, Visit visit)
+{
+    int bricksX = Frame::bricks(frame.size.x), bricksY = Frame::bricks(frame.size.y);
+    for (size_t b = frame.nextBrick(0); b < frame.brickCount(); b = frame.nextBrick(b + 1))
+    {
+        const uint64_t *brick = frame.brickData(b);
+        int bx = (int)(b % bricksX) * 8, by = (int)(b / bricksX % bricksY) * 8, bz = (int)(b / bricksX / bricksY) * 8;
+        for (int lz = 0; lz < 8; ++lz)
+        {
+            uint64_t lit = 0;
+            for (int plane = 0; plane < frame.depth; ++plane)
+                lit |= brick[plane * 8 + lz];
+            while (lit)
+            {
+                int bit = ctz64(lit);
+                lit &= lit - 1;
+                int v = 0;
+                for (int plane = 0; plane < frame.depth; ++plane)
+                    v |= (int)((brick[plane * 8 + lz] >> bit) & 1) << plane;
+                visit(bx + (bit & 7), by + (bit >> 3), bz + lz, v);
+            }
+        }
+    }
+}
+
+void Frame::resize(CubeSize newSize)
+{
+    if (newSize == size)
+        return;
+    Frame resized(newSize, depth);
+    forEachLit(*this, [&](int x, int y, int z, int v)
+               {
+                   if (x < newSize.x && y < newSize.y && z < newSize.z)
+                       resized.setValue(x, y, z, v);
+               });
+    *this = std::move(resized);
+}
+
+void Frame::setDepth(int newDepth, bool rescale)
+{
+    if (newDepth == depth)
+        return;
+    Frame converted(size, newDepth);
+    if (!rescale)
+    {
+        // Planes are stored low bit first, so this adds or drops high bits
+        int kept = std::min(depth, newDepth);
+        for (size_t b = nextBrick(0); b < brickCount(); b = nextBrick(b + 1))
+            std::copy_n(brickData(b), kept * 8, converted.editBrick(b));
+        converted.compact();
+        *this = std::move(converted);
+        return;
+    }
+    int oldMax = maxValue(), newMax = converted.maxValue();
+    forEachLit(*this, [&](int x, int y, int z, int v)
+               {
+                   // Keep dim LEDs lit when the range shrinks
+                   converted.setValue(x, y, z, std::max(1, (v * newMax + oldMax / 2) / oldMax));
+               });
+    *this = std::move(converted);
+}
+
+void Frame::fillLayerX(int x, bool on)
+{
+    // Column x % 8 of every row in the slice words of brick column x / 8
+    uint64_t mask = 0x0101010101010101ull << (x & 7);
+    int bx = x >> 3, bricksX = bricks(size.x), bricksY = bricks(size.y);
+    int rows = size.y & 7 ? size.y & 7 : 8; // valid rows in the last brick row
+    uint64_t lastRowMask = rows == 8 ? ~0ull : (1ull << (rows * 8)) - 1;
+    for (int bz = 0; bz < bricks(size.z); ++bz)
+    {
+        for (int by = 0; by < bricksY; ++by)
+        {
+            size_t b = (size_t)(bz * bricksY + by) * bricksX + bx;
+            if (!on && !brickData(b))
+                continue;
+            uint64_t m = by == bricksY - 1 ? mask & lastRowMask : mask;
+            int slices = std::min(8, size.z - bz * 8);
+            uint64_t *brick = editBrick(b);
+            for (int plane = 0; plane < depth; ++plane)
+                for (int lz = 0; lz < slices; ++lz)
+                    brick[plane * 8 + lz] = on ? brick[plane * 8 + lz] | m : brick[plane * 8 + lz] & ~m;
+        }
+    }
+}
+
+size_t Frame::count() const
+{
+    size_t total = 0;
+    for (size_t b = nextBrick(0); b < brickCount(); b = nextBrick(b + 1))
+        for (int lz = 0; lz < 8; ++lz)
+            total += popcount64(litWord(b * 8 + lz));
+    return total;
+}
+
+void Frame::compact()
+{
+    // Repack in brick order, so frames built differently end up laid out alike
+    Frame packed(size, depth);
+    size_t words = brickWords();
+    for (size_t b = nextBrick(0); b < brickCount(); b = nextBrick(b + 1))
+    {
+        const uint64_t *brick = brickData(b);
+        if (std::any_of(brick, brick + words, [](uint64_t w) { return w != 0; }))
+            std::copy_n(brick, words, packed.editBrick(b));
+    }
+    *this = std::move(packed);
+}
+
+size_t Frame::nextBrick(size_t brick) const
+{
+    size_t total = brickCount();
+    while (brick < total)
+    {
+        size_t group = brick / GROUP_BRICKS;
+        if (groups[group] == EMPTY_BRICK)
+            brick = (group + 1) * GROUP_BRICKS;
+        else if (slots[groups[group] * GROUP_BRICKS + brick % GROUP_BRICKS] == EMPTY_BRICK)
+            ++brick;
+        else
+            return brick;
+    }
+    return total;
+}
+
+bool Frame::operator==(const Frame &other) const
+{
+    if (size != other.size || depth != other.depth)
+        return false;
+    size_t words = brickWords();
+    size_t total = brickCount();
+    for (size_t b = std::min(nextBrick(0), other.nextBrick(0)); b < total;
+         b = std::min(nextBrick(b + 1), other.nextBrick(b + 1)))
+    {
+        const uint64_t *mine = brickData(b), *theirs = other.brickData(b);
+        for (size_t i = 0; i < words; ++i)
+            if ((mine ? mine[i] : 0) != (theirs ? theirs[i] : 0))
+                return false;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,311 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_FRAME_H_
+#define _LEDCUBEEDITOR_FRAME_H_
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+constexpr int DEFAULT_CUBE_SIZE = 8;
+constexpr int MAX_CUBE_SIZE = 256;
+constexpr int MAX_VOXEL_DEPTH = 8; // bits of brightness or palette index per LED
+constexpr int MAX_PALETTE_SIZE = 1 << MAX_VOXEL_DEPTH;
+
+// Cube dimensions in LEDs, z is the vertical axis
+struct CubeSize
+{
+    int x = DEFAULT_CUBE_SIZE;
+    int y = DEFAULT_CUBE_SIZE;
+    int z = DEFAULT_CUBE_SIZE;
+
+    int count() const { return x * y * z; }
+    bool valid() const
+    {
+        return x >= 1 && y >= 1 && z >= 1 &&
+               x <= MAX_CUBE_SIZE && y <= MAX_CUBE_SIZE && z <= MAX_CUBE_SIZE;
+    }
+    bool operator==(const CubeSize &other) const { return x == other.x && y == other.y && z == other.z; }
+    bool operator!=(const CubeSize &other) const { return !(*this == other); }
+};
+
+inline int popcount64(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    return (int)std::bitset<64>(word).count();
+#endif
+}
+
+// Smallest bit depth that can index `values` distinct voxel values
+inline int depthForValues(size_t values)
+{
+    int depth = 1;
+    while (((size_t)1 << depth) < values)
+        ++depth;
+    return depth;
+}
+
+inline int ctz64(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int n = 0;
+    while (!(word & 1))
+    {
+        word >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Each LED holds a `depth`-bit value, a brightness or a palette index, stored
+// as `depth` bit-planes. The cube is cut into 8x8x8 bricks numbered x first,
+// then y, then z. A brick plane is eight words, one per z slice, holding voxel
+// (x, y) of the slice in bit (y % 8) * 8 + x % 8.
+//
+// Only bricks with lit LEDs need storage. A two-level brick map finds a brick's
+// words in `store`, all its planes back to back: `groups` has an entry per run
+// of GROUP_BRICKS bricks pointing at a block of `slots`, and `slots` an entry
+// per brick of the run. EMPTY_BRICK at either level reads as all off, so a dark
+// run costs one entry. Memory and whole-frame operations, which step through
+// the stored bricks with nextBrick(), scale with the lit part of the cube.
+// word() still offers the dense layout of planeWords() words per plane, brick
+// after brick, that the renderer and the undo journal address.
+// Padding bits past the real size are always zero.
+struct Frame
+{
+    static constexpr uint32_t EMPTY_BRICK = 0xffffffffu;
+    static constexpr size_t GROUP_BRICKS = 64;
+
+    Frame() : Frame(CubeSize()) {}
+    explicit Frame(CubeSize size, int depth = 1)
+        : size(size), depth(depth), groups((brickCount(size) + GROUP_BRICKS - 1) / GROUP_BRICKS, EMPTY_BRICK) {}
+
+    CubeSize size;
+    int depth;
+    std::vector<uint32_t> groups; // per run of bricks: its block of `slots` / GROUP_BRICKS
+    std::vector<uint32_t> slots;  // per brick of a block: its words in `store` / brickWords()
+    std::vector<uint64_t> store;
+
+    static int bricks(int n) { return (n + 7) >> 3; }
+    static size_t brickCount(CubeSize size) { return (size_t)bricks(size.x) * bricks(size.y) * bricks(size.z); }
+    static size_t wordCount(CubeSize size) { return brickCount(size) * 8; }
+    static uint64_t bitMask(int x, int y) { return 1ull << (((y & 7) << 3) | (x & 7)); }
+
+    int wordIndex(int x, int y, int z) const
+    {
+        return (((z >> 3) * bricks(size.y) + (y >> 3)) * bricks(size.x) + (x >> 3)) * 8 + (z & 7);
+    }
+    size_t brickCount() const { return brickCount(size); }
+    size_t planeWords() const { return wordCount(size); }
+    size_t brickWords() const { return (size_t)depth * 8; }
+    int maxValue() const { return (1 << depth) - 1; }
+
+    // Where the words of a brick start in `store` / brickWords(), or EMPTY_BRICK
+    uint32_t slot(size_t brick) const
+    {
+        uint32_t group = groups[brick / GROUP_BRICKS];
+        return group == EMPTY_BRICK ? EMPTY_BRICK : slots[group * GROUP_BRICKS + brick % GROUP_BRICKS];
+    }
+    void setSlot(size_t brick, uint32_t index)
+    {
+        uint32_t &group = groups[brick / GROUP_BRICKS];
+        if (group == EMPTY_BRICK)
+        {
+            group = (uint32_t)(slots.size() / GROUP_BRICKS);
+            slots.resize(slots.size() + GROUP_BRICKS, EMPTY_BRICK);
+        }
+        slots[group * GROUP_BRICKS + brick % GROUP_BRICKS] = index;
+    }
+    // Words of a brick, plane 0 first, or null when it isn't stored
+    const uint64_t *brickData(size_t brick) const
+    {
+        uint32_t index = slot(brick);
+        return index == EMPTY_BRICK ? nullptr : &store[index * brickWords()];
+    }
+    // Same, storing the brick first when it isn't
+    uint64_t *editBrick(size_t brick)
+    {
+        uint32_t index = slot(brick);
+        if (index == EMPTY_BRICK)
+        {
+            index = (uint32_t)storedBricks();
+            setSlot(brick, index);
+            store.resize(store.size() + brickWords(), 0);
+        }
+        return &store[index * brickWords()];
+    }
+    // First stored brick from `brick` on, brickCount() past the last
+    size_t nextBrick(size_t brick) const;
+    size_t storedBricks() const { return store.size() / brickWords(); }
+    size_t bytes() const { return (groups.size() + slots.size()) * sizeof(uint32_t) + store.size() * sizeof(uint64_t); }
+
+    // Word `index` of the dense layout, planes back to back
+    uint64_t word(size_t index) const
+    {
+        size_t plane = index / planeWords(), i = index % planeWords();
+        const uint64_t *brick = brickData(i >> 3);
+        return brick ? brick[plane * 8 + (i & 7)] : 0;
+    }
+    uint64_t &wordRef(size_t index)
+    {
+        size_t plane = index / planeWords(), i = index % planeWords();
+        return editBrick(i >> 3)[plane * 8 + (i & 7)];
+    }
+    // Word `index` of every plane OR-ed together: the LEDs that are lit at all
+    uint64_t litWord(size_t index) const
+    {
+        const uint64_t *brick = brickData(index >> 3);
+        uint64_t word = 0;
+        for (int plane = 0; brick && plane < depth; ++plane)
+            word |= brick[plane * 8 + (index & 7)];
+        return word;
+    }
+    bool planeBit(int plane, int x, int y, int z) const
+    {
+        int i = wordIndex(x, y, z);
+        const uint64_t *brick = brickData(i >> 3);
+        return brick && (brick[plane * 8 + (i & 7)] & bitMask(x, y)) != 0;
+    }
+    void setPlaneBit(int plane, int x, int y, int z, bool on)
+    {
+        int i = wordIndex(x, y, z);
+        if (!on && !brickData(i >> 3))
+            return;
+        uint64_t &word = editBrick(i >> 3)[plane * 8 + (i & 7)];
+        word = on ? (word | bitMask(x, y)) : (word & ~bitMask(x, y));
+    }
+
+    int value(int x, int y, int z) const
+    {
+        int v = 0;
+        for (int plane = 0; plane < depth; ++plane)
+            v |= planeBit(plane, x, y, z) << plane;
+        return v;
+    }
+    void setValue(int x, int y, int z, int v)
+    {
+        for (int plane = 0; plane < depth; ++plane)
+            setPlaneBit(plane, x, y, z, (v >> plane) & 1);
+    }
+
+    // On/off view: any brightness counts as on, turning on means full brightness
+    bool get(int x, int y, int z) const { return (litWord(wordIndex(x, y, z)) & bitMask(x, y)) != 0; }
+    void set(int x, int y, int z, bool on) { setValue(x, y, z, on ? maxValue() : 0); }
+    void toggle(int x, int y, int z) { set(x, y, z, !get(x, y, z)); }
+
+    void clear()
+    {
+        std::fill(groups.begin(), groups.end(), EMPTY_BRICK);
+        slots.clear();
+        store.clear();
+    }
+    // Set a whole x layer to full brightness or off
+    void fillLayerX(int x, bool on);
+    // Number of lit LEDs
+    size_t count() const;
+    // Release the stored bricks that have gone dark
+    void compact();
+
+    // Equal contents, however the bricks happen to be stored
+    bool operator==(const Frame &other) const;
+    bool operator!=(const Frame &other) const { return !(*this == other); }
+
+    // Change the dimensions, keeping the voxels that fit in both sizes
+    void resize(CubeSize newSize);
+    // Change the bits per LED, rescaling every brightness to the new range or,
+    // for palette indices, keeping the values as they are
+    void setDepth(int newDepth, bool rescale = true);
+};
+
+// Where frames that are not decoded yet come from, like a mapped .cbin file.
+// Frames are decoded when asked for and not kept by the source, so playing a
+// long file holds only a handful of them. Safe to use from several threads.
+class FrameSource
+{
+public:
+    FrameSource() { contentsChanged(); }
+    virtual ~FrameSource() = default;
+    // A fresh decode, for passes that look at each frame once
+    virtual Frame decode(size_t index) const = 0;
+
+    // Goes through a few frames recently decoded on the calling thread. The
+    // reference stays valid until that thread has asked any source for
+    // RECENT_FRAMES other frames.
+    const Frame &frame(size_t index) const;
+    static constexpr size_t RECENT_FRAMES = 8;
+
+protected:
+    // Call when index now means another frame, so nothing decoded before is reused
+    void contentsChanged();
+
+private:
+    uint64_t id = 0;
+};
+
+// Which contents a handle refers to: the same for handles sharing them and for
+// lazy handles of one source frame. The address get() gives a lazy handle is
+// only lent from the source's recent frames and gets reused, so code telling
+// frames apart keys on this instead.
+struct FrameId
+{
+    const void *owner = nullptr; // the shared contents, or the source of a lazy frame
+    size_t index = 0;            // lazy frames only
+
+    bool operator==(const FrameId &other) const { return owner == other.owner && index == other.index; }
+    bool operator!=(const FrameId &other) const { return !(*this == other); }
+};
+
+struct FrameIdHash
+{
+    size_t operator()(const FrameId &id) const
+    {
+        return std::hash<const void *>()(id.owner) ^ id.index * 0x9e3779b97f4a7c15ull;
+    }
+};
+
+// Reference to frame contents kept in the frame pool (frame_store.h). Copying
+// a handle shares the contents; edit() first gives the handle a private copy
+// when other handles or the pool refer to them, and intern() hands the result
+// back to the pool so equal frames end up stored once.
+//
+// A lazy handle refers to a frame of a FrameSource instead, and only takes
+// contents of its own once edited.
+class FrameHandle
+{
+public:
+    FrameHandle() : FrameHandle(Frame()) {}
+    explicit FrameHandle(Frame frame) : frame(std::make_shared<Frame>(std::move(frame))) {}
+    static FrameHandle lazy(std::shared_ptr<const FrameSource> source, size_t index);
+
+    const Frame &operator*() const { return frame ? *frame : source->frame(index); }
+    const Frame *operator->() const { return &**this; }
+    const Frame *get() const { return &**this; }
+    FrameId id() const { return frame ? FrameId{frame.get(), 0} : FrameId{source.get(), index}; }
+
+    // False for a lazy handle that has not been edited
+    bool loaded() const { return frame != nullptr; }
+    // The contents, decoded without going through the recent frames when lazy
+    Frame decode() const { return frame ? *frame : source->decode(index); }
+
+    Frame &edit();
+    void intern();
+
+private:
+    friend class FramePool;
+
+    FrameHandle(std::shared_ptr<const FrameSource> source, size_t index) : source(std::move(source)), index(index) {}
+
+    std::shared_ptr<Frame> frame;
+    std::shared_ptr<const FrameSource> source; // lazy handles only
+    size_t index = 0;
+    bool pooled = false;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
+#include "frame_store.h"
+
+uint64_t hashFrame(const Frame &frame)
+{
+    uint64_t h = (uint64_t)frame.size.x | (uint64_t)frame.size.y << 16 | (uint64_t)frame.size.z << 32 |
+                 (uint64_t)frame.depth << 48;
+    // Dark bricks hash alike whether they are stored or not
+    size_t words = frame.brickWords();
+    for (size_t b = frame.nextBrick(0); b < frame.brickCount(); b = frame.nextBrick(b + 1))
+    {
+        const uint64_t *brick = frame.brickData(b);
+        if (std::all_of(brick, brick + words, [](uint64_t w) { return w == 0; }))
+            continue;
+        h ^= b * 0x94d049bb133111ebull;
+        for (size_t i = 0; i < words; ++i)
+        {
+            h ^= brick[i] * 0x9e3779b97f4a7c15ull;
+            h = (h << 31 | h >> 33) * 0xbf58476d1ce4e5b9ull;
+        }
+    }
+    return h ^ (h >> 29);
+}
+
+void FrameSource::contentsChanged()
+{
+    // Not the address, a later source may be allocated where this one was
+    static std::atomic<uint64_t> nextId{1};
+    id = nextId++;
+}
+
+const Frame &FrameSource::frame(size_t index) const
+{
+    struct Recent
+    {
+        uint64_t source = 0;
+        size_t index = 0;
+        uint64_t used = 0;
+        std::unique_ptr<const Frame> frame;
+    };
+    thread_local Recent recent[RECENT_FRAMES];
+    thread_local uint64_t clock = 0;
+
+    Recent *oldest = &recent[0];
+    for (auto &entry : recent)
+    {
+        if (entry.frame && entry.source == id && entry.index == index)
+        {
+            entry.used = ++clock;
+            return *entry.frame;
+        }
+        if (entry.used < oldest->used)
+            oldest = &entry;
+    }
+    oldest->frame = std::make_unique<const Frame>(decode(index));
+    oldest->source = id;
+    oldest->index = index;
+    oldest->used = ++clock;
+    return *oldest->frame;
+}
+
+FrameHandle FrameHandle::lazy(std::shared_ptr<const FrameSource> source, size_t index)
+{
+    return FrameHandle(std::move(source), index);
+}
+
+Frame &FrameHandle::edit()
+{
+    if (!frame)
+    {
+        frame = std::make_shared<Frame>(source->decode(index));
+        source.reset();
+        pooled = false;
+    }
+    else if (frame.use_count() > 1)
+    {
+        frame = std::make_shared<Frame>(*frame);
+        pooled = false;
+    }
+    else if (pooled)
+    {
+        // Another thread's intern() may have picked the frame up since the check above
+        if (!framePool().release(*this))
+            frame = std::make_shared<Frame>(*frame);
+        pooled = false;
+    }
+    return *frame;
+}
+
+void FrameHandle::intern()
+{
+    if (pooled || !frame)
+        return; // lazy frames stay in their source until edited
+    if (frame.use_count() == 1)
+        frame->compact(); // nobody else can be reading it
+    framePool().intern(*this);
+}
+
+void FramePool::intern(FrameHandle &handle)
+{
+    uint64_t h = hashFrame(*handle.frame);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = frames.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        std::shared_ptr<Frame> pooled = it->second.lock();
+        if (pooled && *pooled == *handle.frame)
+        {
+            handle.frame = std::move(pooled);
+            handle.pooled = true;
+            return;
+        }
+    }
+    frames.emplace(h, handle.frame);
+    handle.pooled = true;
+    if (frames.size() >= sweepAt)
+    {
+        sweep();
+        sweepAt = frames.size() * 2 + 64;
+    }
+}
+
+bool FramePool::release(FrameHandle &handle)
+{
+    uint64_t h = hashFrame(*handle.frame);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = frames.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second.lock() == handle.frame)
+        {
+            frames.erase(it);
+            break;
+        }
+    }
+    // With the entry gone nobody can pick the frame up any more, so the count
+    // taken under the lock is final
+    return handle.frame.use_count() == 1;
+}
+
+size_t FramePool::entries()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    sweep();
+    return frames.size();
+}
+
+void FramePool::sweep()
+{
+    for (auto it = frames.begin(); it != frames.end();)
+        it = it->second.expired() ? frames.erase(it) : std::next(it);
+}
+
+FramePool &framePool()
+{
+    static FramePool pool;
+    return pool;
+}
+
+FrameStoreStats frameStoreStats(const Timeline &frames)
+{
+    FrameStoreStats stats;
+    std::unordered_set<const Frame *> seen;
+    for (const auto &handle : frames)
+    {
+        if (!handle.loaded())
+        {
+            stats.frames++;
+            stats.unloaded++;
+            continue;
+        }
+        size_t bytes = handle->bytes();
+        stats.frames++;
+        stats.bytes += bytes;
+        if (seen.insert(handle.get()).second)
+        {
+            stats.unique++;
+            stats.uniqueBytes += bytes;
+        }
+    }
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_FRAME_STORE_H_
+#define _LEDCUBEEDITOR_FRAME_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "frame.h"
+#include "timeline.h"
+
+uint64_t hashFrame(const Frame &frame);
+
+// Content-addressed set of the frames behind every FrameHandle. Entries are
+// weak, so contents are freed with their last handle and expired entries are
+// swept out as the pool grows. Safe to use from several threads.
+class FramePool
+{
+public:
+    // Point `handle` at an equal pooled frame, or pool its contents
+    void intern(FrameHandle &handle);
+    // Drop the entry of `handle`'s contents before they get modified in place.
+    // False when another handle took them from the pool first, they must then
+    // be copied instead.
+    bool release(FrameHandle &handle);
+    size_t entries();
+
+private:
+    void sweep();
+
+    std::mutex mutex;
+    std::unordered_multimap<uint64_t, std::weak_ptr<Frame>> frames;
+    size_t sweepAt = 64;
+};
+
+FramePool &framePool();
+
+struct FrameStoreStats
+{
+    size_t frames = 0;      // handles in the animation
+    size_t unique = 0;      // distinct contents behind them
+    size_t bytes = 0;       // what one copy per frame would take
+    size_t uniqueBytes = 0; // what is actually stored
+    size_t unloaded = 0;    // lazy frames, left out of the rest
+};
+
+FrameStoreStats frameStoreStats(const Timeline &frames);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "main.h"
+#include "image_writer.h"
+#include "cbin_stream.h"
+
+struct HeadlessOptions
+{
+    std::vector<std::string> inputs;
+    std::string outDir = ".";
+    std::string format = "png"; // png, rgb or y4m
+    int width = 512;
+    int height = 512;
+    int mode = DISPLAY_LEDS;
+};
+
+static void printUsage()
+{
+    std::cerr << "Usage: ledcubeeditor --render [options] file.cbin...\n"
+                 "  --out DIR              output directory (default .)\n"
+                 "  --format png|rgb|y4m   PNG sequence, raw RGB24 stream or Y4M video (default png)\n"
+                 "  --size WxH             image size (default 512x512)\n"
+                 "  --mode leds|solid|raymarch\n";
+}
+
+static bool parseOptions(int argc, char **argv, HeadlessOptions &options)
+{
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue)
+            options.outDir = argv[++i];
+        else if (arg == "--format" && hasValue)
+            options.format = argv[++i];
+        else if (arg == "--size" && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2)
+                return false;
+        }
+        else if (arg == "--mode" && hasValue)
+        {
+            std::string mode = argv[++i];
+            if (mode == "leds")
+                options.mode = DISPLAY_LEDS;
+            else if (mode == "solid")
+                options.mode = DISPLAY_SOLID;
+            else if (mode == "raymarch")
+                options.mode = DISPLAY_RAYMARCH;
+            else
+                return false;
+        }
+        else if (arg.rfind("--", 0) == 0)
+            return false;
+        else
+            options.inputs.push_back(arg);
+    }
+    return !options.inputs.empty() && options.width > 0 && options.height > 0 &&
+           (options.format == "png" || options.format == "rgb" || options.format == "y4m");
+}
+
+// Render every frame of one animation into the bound framebuffer and write
+// them out in the requested format. Frames are streamed from the file, so long
+// animations never sit in memory whole.
+static bool renderAnimation(const std::string &input, const HeadlessOptions &options)
+{
+    CbinReader reader;
+    if (!reader.open(input.c_str()))
+    {
+        std::cerr << input << ": " << reader.error() << std::endl;
+        return false;
+    }
+    const CbinHeader &header = reader.header();
+    frameCamera(header.size);
+    markFrameDirty();
+    uploadPalette(header.palette);
+
+    std::filesystem::path stem = std::filesystem::path(options.outDir) / std::filesystem::path(input).stem();
+    std::ofstream raw;
+    Y4MWriter y4m;
+    if (options.format == "rgb")
+        raw.open(stem.string() + ".rgb", std::ios::binary);
+    else if (options.format == "y4m")
+    {
+        int delay = header.delay > 0 ? header.delay : 100;
+        if (!y4m.open((stem.string() + ".y4m").c_str(), options.width, options.height, 1000, delay))
+            return false;
+    }
+    if (options.format == "rgb" && !raw)
+        return false;
+
+    size_t stride = (size_t)options.width * 3;
+    std::vector<uint8_t> pixels(stride * options.height), flipped(pixels.size());
+    size_t i = 0;
+    for (const Frame &frame : reader)
+    {
+        glViewport(0, 0, options.width, options.height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawScene(frame, (int)i, options.mode);
+        glReadPixels(0, 0, options.width, options.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+        // GL rows start at the bottom
+        for (int y = 0; y < options.height; ++y)
+            std::memcpy(&flipped[y * stride], &pixels[(options.height - 1 - y) * stride], stride);
+
+        bool ok = true;
+        if (options.format == "png")
+        {
+            char suffix[16];
+            std::snprintf(suffix, sizeof(suffix), "_%05zu.png", i);
+            ok = writePNG((stem.string() + suffix).c_str(), options.width, options.height, flipped.data());
+        }
+        else if (options.format == "rgb")
+        {
+            raw.write(reinterpret_cast<const char *>(flipped.data()), flipped.size());
+            ok = !raw.fail();
+        }
+        else
+        {
+            ok = y4m.writeFrame(flipped.data());
+        }
+        if (!ok)
+        {
+            std::cerr << "Failed to write frame " << i << " of " << input << std::endl;
+            return false;
+        }
+        ++i;
+    }
+    if (!reader.error().empty())
+    {
+        std::cerr << input << ": " << reader.error() << std::endl;
+        return false;
+    }
+    std::cout << input << ": " << i << " frames" << std::endl;
+    return true;
+}
+
+// Batch mode: `ledcubeeditor --render ...` renders .cbin files to images
+// through an offscreen framebuffer and exits
+int runHeadless(int argc, char **argv)
+{
+    HeadlessOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(options.outDir, error);
+
+    if (!setupHeadlessRenderer(options.width, options.height))
+    {
+        std::cerr << "Could not create an offscreen OpenGL context." << std::endl;
+        return 1;
+    }
+
+    GLuint fbo, colorBuffer, depthBuffer;
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, options.width, options.height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    int failures = 0;
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Offscreen framebuffer is incomplete." << std::endl;
+        failures = (int)options.inputs.size();
+    }
+    else
+    {
+        for (const auto &input : options.inputs)
+            failures += renderAnimation(input, options) ? 0 : 1;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    destroyHeadlessRenderer();
+    return failures ? 1 : 0;
+}
\ No newline at end of file
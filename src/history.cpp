@@ -0,0 +1,241 @@
+#include "history.h"
+
+void EditHistory::beginEdit(const Animation &animation, int frameIndex, int layer)
+{
+    if (open && openFrame == frameIndex && openLayer == layer && before.size() == 1)
+        return;
+    beginRangeEdit(animation, frameIndex, 1, layer);
+}
+
+void EditHistory::beginRangeEdit(const Animation &animation, int first, int count, int layer)
+{
+    if (open)
+        endEdit(animation);
+    // Handle copies are enough: the edit itself will copy-on-write
+    const Timeline &frames = animation.layerFrames(layer);
+    before.clear();
+    for (int i = first; i < first + count && i < (int)frames.size(); ++i)
+        before.push_back(frames[i]);
+    openLayer = layer;
+    openFrame = first;
+    open = true;
+}
+
+// Indices are into the dense layout of Frame::word(); bricks dark in both
+// versions are skipped without looking at them
+static void frameDelta(const Frame &old, const Frame &now, std::vector<uint32_t> &delta)
+{
+    size_t planeWords = now.planeWords();
+    size_t total = now.brickCount();
+    for (size_t b = std::min(old.nextBrick(0), now.nextBrick(0)); b < total;
+         b = std::min(old.nextBrick(b + 1), now.nextBrick(b + 1)))
+    {
+        const uint64_t *was = old.brickData(b), *is = now.brickData(b);
+        for (int plane = 0; plane < now.depth; ++plane)
+            for (int lz = 0; lz < 8; ++lz)
+            {
+                uint64_t changed = (was ? was[plane * 8 + lz] : 0) ^ (is ? is[plane * 8 + lz] : 0);
+                if (!changed)
+                    continue;
+                delta.push_back((uint32_t)(plane * planeWords + b * 8 + lz));
+                delta.push_back((uint32_t)changed);
+                delta.push_back((uint32_t)(changed >> 32));
+            }
+    }
+}
+
+void EditHistory::endEdit(const Animation &animation)
+{
+    if (!open)
+        return;
+    open = false;
+    std::vector<FrameHandle> previous = std::move(before);
+    before.clear();
+    if (openLayer > (int)animation.layers.size())
+        return;
+    const Timeline &frames = animation.layerFrames(openLayer);
+
+    std::vector<Entry> entries;
+    size_t stepBytes = 0;
+    for (size_t i = 0; i < previous.size() && openFrame + i < frames.size(); ++i)
+    {
+        const FrameHandle &current = frames[openFrame + i];
+        if (current.id() == previous[i].id())
+            continue; // still the same contents
+        const Frame &old = *previous[i];
+        const Frame &now = *current;
+        if (old.size != now.size || old.depth != now.depth)
+            continue;
+        Entry entry{nextStep, openLayer, openFrame + (int)i, (uint32_t)(now.planeWords() * now.depth), {}};
+        frameDelta(old, now, entry.delta);
+        if (entry.delta.empty())
+            continue;
+        entry.delta.shrink_to_fit();
+        stepBytes += entry.bytes();
+        if (stepBytes > maxBytes)
+        {
+            // Trimming would drop this step and everything before it anyway
+            clear();
+            return;
+        }
+        entries.push_back(std::move(entry));
+    }
+    if (entries.empty())
+        return;
+    nextStep++;
+
+    for (const auto &dropped : redoStack)
+        usedBytes -= dropped.bytes();
+    redoStack.clear();
+    usedBytes += stepBytes;
+    for (auto &entry : entries)
+        undoStack.push_back(std::move(entry));
+    trim();
+}
+
+int EditHistory::apply(Animation &animation, std::deque<Entry> &from, std::deque<Entry> &to)
+{
+    if (open)
+        endEdit(animation);
+    if (from.empty())
+        return -1;
+    // Entries of a step change different frames, so their order does not matter
+    uint32_t step = from.back().step;
+    int first = -1, last = -1;
+    while (!from.empty() && from.back().step == step)
+    {
+        Entry entry = std::move(from.back());
+        from.pop_back();
+        Timeline *frames = entry.layer <= (int)animation.layers.size() ? &animation.layerFrames(entry.layer) : nullptr;
+        if (!frames || entry.frame >= (int)frames->size() ||
+            (*frames)[entry.frame]->planeWords() * (*frames)[entry.frame]->depth != entry.words)
+        {
+            usedBytes -= entry.bytes();
+            continue;
+        }
+
+        FrameHandle &handle = (*frames)[entry.frame];
+        Frame &frame = handle.edit();
+        for (size_t i = 0; i < entry.delta.size(); i += 3)
+            frame.wordRef(entry.delta[i]) ^= entry.delta[i + 1] | (uint64_t)entry.delta[i + 2] << 32;
+        handle.intern();
+        first = first < 0 ? entry.frame : std::min(first, entry.frame);
+        last = std::max(last, entry.frame);
+        appliedLayer = entry.layer;
+        to.push_back(std::move(entry));
+    }
+    appliedSpan = first < 0 ? 0 : last - first + 1;
+    return first;
+}
+
+int EditHistory::undo(Animation &animation)
+{
+    return apply(animation, undoStack, redoStack);
+}
+
+int EditHistory::redo(Animation &animation)
+{
+    return apply(animation, redoStack, undoStack);
+}
+
+void EditHistory::framesInserted(int at, int count)
+{
+    for (auto *stack : {&undoStack, &redoStack})
+        for (auto &entry : *stack)
+            if (entry.layer == 0 && entry.frame >= at)
+                entry.frame += count;
+    if (open && openLayer == 0 && openFrame >= at)
+        openFrame += count;
+}
+
+void EditHistory::framesRemoved(int at, int count)
+{
+    for (auto *stack : {&undoStack, &redoStack})
+    {
+        for (auto it = stack->begin(); it != stack->end();)
+        {
+            if (it->layer != 0)
+            {
+                ++it;
+                continue;
+            }
+            if (it->frame >= at && it->frame < at + count)
+            {
+                usedBytes -= it->bytes();
+                it = stack->erase(it);
+                continue;
+            }
+            if (it->frame >= at + count)
+                it->frame -= count;
+            ++it;
+        }
+    }
+    if (!open || openLayer != 0)
+        return;
+    if (openFrame < at + count && openFrame + (int)before.size() > at)
+    {
+        open = false;
+        before.clear();
+    }
+    else if (openFrame >= at + count)
+        openFrame -= count;
+}
+
+// Same mapping as Timeline::move: [at, at + count) ends up starting at `to`
+void EditHistory::framesMoved(int at, int count, int to)
+{
+    auto remap = [&](int frame)
+    {
+        if (frame >= at && frame < at + count)
+            return to + frame - at;
+        int rest = frame < at ? frame : frame - count; // index with the range taken out
+        return rest < to ? rest : rest + count;
+    };
+    for (auto *stack : {&undoStack, &redoStack})
+        for (auto &entry : *stack)
+            if (entry.layer == 0)
+                entry.frame = remap(entry.frame);
+    if (open && openLayer == 0)
+        openFrame = remap(openFrame);
+}
+
+void EditHistory::clear()
+{
+    undoStack.clear();
+    redoStack.clear();
+    usedBytes = 0;
+    open = false;
+    before.clear();
+}
+
+void EditHistory::setBudget(size_t bytes)
+{
+    maxBytes = bytes;
+    trim();
+}
+
+// Drop the oldest steps, redo steps first since they are the least likely used
+void EditHistory::trim()
+{
+    auto dropOldest = [&](std::deque<Entry> &stack)
+    {
+        uint32_t step = stack.front().step;
+        while (!stack.empty() && stack.front().step == step)
+        {
+            usedBytes -= stack.front().bytes();
+            stack.pop_front();
+        }
+    };
+    while (usedBytes > maxBytes && !redoStack.empty())
+        dropOldest(redoStack);
+    while (usedBytes > maxBytes && !undoStack.empty())
+        dropOldest(undoStack);
+}
+
+size_t EditHistory::steps(const std::deque<Entry> &stack)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < stack.size(); ++i)
+        count += i == 0 || stack[i].step != stack[i - 1].step;
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_HISTORY_H_
+#define _LEDCUBEEDITOR_HISTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "animation.h"
+
+// Undo/redo journal of voxel edits. An entry keeps only the Frame::word()s
+// an edit changed, as (index, before ^ after) triples of uint32s, so undoing
+// and redoing are the same XOR. Edits between beginEdit() and endEdit(), such
+// as a drag stroke, become one step; an edit of a range of frames, such as a
+// transform, is one step of an entry per changed frame. The oldest steps are
+// dropped once the journal outgrows its byte budget.
+class EditHistory
+{
+public:
+    // Remember frame `frameIndex` of a layer (see Animation::layerFrames) as it
+    // is before an edit. A no-op while an edit of the same frame is already open.
+    void beginEdit(const Animation &animation, int frameIndex, int layer = 0);
+    // The same for frames [first, first + count), undone and redone together
+    void beginRangeEdit(const Animation &animation, int first, int count, int layer = 0);
+    // Record the changes since beginEdit() as one undo step
+    void endEdit(const Animation &animation);
+    bool editing() const { return open; }
+
+    bool canUndo() const { return !undoStack.empty(); }
+    bool canRedo() const { return !redoStack.empty(); }
+    // Both return the index of the first frame they changed, or -1;
+    // changedLayer() tells which layer it belongs to and changedSpan() how many
+    // frames from there on may have changed
+    int undo(Animation &animation);
+    int redo(Animation &animation);
+    int changedLayer() const { return appliedLayer; }
+    int changedSpan() const { return appliedSpan; }
+
+    // Keep frame indices valid when the animation's own frames (layer 0) are
+    // inserted or removed
+    void framesInserted(int at, int count);
+    void framesRemoved(int at, int count);
+    void framesMoved(int at, int count, int to);
+    // Forget everything, e.g. after a resize that invalidates all word indices
+    void clear();
+
+    void setBudget(size_t bytes);
+    size_t budget() const { return maxBytes; }
+    size_t bytes() const { return usedBytes; }
+    size_t undoSteps() const { return steps(undoStack); }
+    size_t redoSteps() const { return steps(redoStack); }
+
+private:
+    struct Entry
+    {
+        uint32_t step; // entries of one step share it
+        int layer;
+        int frame;
+        uint32_t words;              // dense word count of the frame the delta applies to
+        std::vector<uint32_t> delta; // index, low xor, high xor
+        size_t bytes() const { return sizeof(Entry) + delta.capacity() * sizeof(uint32_t); }
+    };
+
+    int apply(Animation &animation, std::deque<Entry> &from, std::deque<Entry> &to);
+    void trim();
+    static size_t steps(const std::deque<Entry> &stack);
+
+    bool open = false;
+    int openLayer = 0;
+    int openFrame = -1;
+    int appliedLayer = 0;
+    int appliedSpan = 0;
+    uint32_t nextStep = 0;
+    std::vector<FrameHandle> before; // from openFrame on
+    std::deque<Entry> undoStack, redoStack;
+    size_t usedBytes = 0;
+    size_t maxBytes = 256 * 1024;
+};
+
+#endif
\ No newline at end of file
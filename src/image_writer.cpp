@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstring>
+#include "image_writer.h"
+
+static uint32_t crcTable[256];
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t length)
+{
+    if (!crcTable[1])
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crcTable[n] = c;
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i)
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void putBE32(std::vector<uint8_t> &out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+static void writeChunk(std::ofstream &out, const char type[4], const std::vector<uint8_t> &data)
+{
+    std::vector<uint8_t> chunk;
+    chunk.reserve(data.size() + 12);
+    putBE32(chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    putBE32(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+    out.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+}
+
+bool writePNG(const char *path, int width, int height, const uint8_t *rgb)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.write(reinterpret_cast<const char *>(signature), 8);
+
+    std::vector<uint8_t> header;
+    putBE32(header, width);
+    putBE32(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, no interlace
+    writeChunk(out, "IHDR", header);
+
+    // Scanlines with filter type 0, wrapped in stored (uncompressed) deflate blocks
+    size_t stride = (size_t)width * 3;
+    std::vector<uint8_t> raw;
+    raw.reserve((stride + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + y * stride, rgb + (y + 1) * stride);
+    }
+
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    size_t offset = 0;
+    do
+    {
+        size_t length = std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + length == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(length & 0xFF);
+        zlib.push_back(length >> 8);
+        zlib.push_back(~length & 0xFF);
+        zlib.push_back((~length >> 8) & 0xFF);
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+
+    uint32_t a = 1, b = 0; // Adler-32
+    for (uint8_t byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBE32(zlib, (b << 16) | a);
+    writeChunk(out, "IDAT", zlib);
+    writeChunk(out, "IEND", {});
+    return !out.fail();
+}
+
+bool Y4MWriter::open(const char *path, int w, int h, int fpsNum, int fpsDen)
+{
+    out.open(path, std::ios::binary);
+    if (!out)
+        return false;
+    width = w;
+    height = h;
+    planes.resize((size_t)w * h * 3);
+    out << "YUV4MPEG2 W" << w << " H" << h << " F" << fpsNum << ":" << fpsDen << " Ip A1:1 C444\n";
+    return !out.fail();
+}
+
+bool Y4MWriter::writeFrame(const uint8_t *rgb)
+{
+    size_t pixels = (size_t)width * height;
+    uint8_t *yPlane = planes.data(), *uPlane = yPlane + pixels, *vPlane = uPlane + pixels;
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        int r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+        yPlane[i] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        uPlane[i] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        vPlane[i] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+    out << "FRAME\n";
+    out.write(reinterpret_cast<const char *>(planes.data()), planes.size());
+    return !out.fail();
+}
\ No newline at end of file
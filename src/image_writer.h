@@ -0,0 +1,28 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_IMAGE_WRITER_H_
+#define _LEDCUBEEDITOR_IMAGE_WRITER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Images are 8-bit RGB, rows from top to bottom
+
+// Uncompressed (stored deflate) PNG, cheap to write and readable everywhere
+bool writePNG(const char *path, int width, int height, const uint8_t *rgb);
+
+// YUV4MPEG2 stream in 4:4:4 BT.601 video range, readable by ffmpeg and x264
+class Y4MWriter
+{
+public:
+    bool open(const char *path, int width, int height, int fpsNum, int fpsDen);
+    bool writeFrame(const uint8_t *rgb);
+    void close() { out.close(); }
+
+private:
+    std::ofstream out;
+    int width = 0, height = 0;
+    std::vector<uint8_t> planes;
+};
+
+#endif
\ No newline at end of file
@@ -1,12 +1,17 @@
+#include <cstring>
 #include <vector>
 #include "main.h"
-std::vector<Frame> frames;
+Animation animation;
 
-int main()
+int main(int argc, char **argv)
 {
-    frames.emplace_back(); // one empty frame
+    if (argc > 1 && std::strcmp(argv[1], "--render") == 0)
+        return runHeadless(argc, argv);
+
+    animation.frames.push_back(FrameHandle(Frame(animation.size))); // one empty frame
+    animation.frames.back().intern();
     setupRenderer();
-    mainLoop(frames);
+    mainLoop(animation);
     destroyRenderer();
     return 0;
 }
\ No newline at end of file
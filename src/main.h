@@ -3,23 +3,54 @@
 #define _LEDCUBEEDITOR_MAIN_H_
 
 #include <cstdint>
+#include <functional>
 #include <vector>
 #include <glm/glm.hpp>
 #include <GLFW/glfw3.h>
+#include "animation.h"
 
-constexpr int CUBE_SIZE = 8;
+class ShaderProgram;
 
-struct Frame
+enum DisplayMode
 {
-    uint8_t voxels[CUBE_SIZE][CUBE_SIZE][CUBE_SIZE] = {};
+    DISPLAY_LEDS,
+    DISPLAY_SOLID,
+    DISPLAY_RAYMARCH,
 };
 
 void setupRenderer();
 void destroyRenderer();
-void mainLoop(std::vector<Frame> &frames);
-void drawCube3D(const uint8_t cube[8][8][8], GLuint shaderProgram, GLuint cubeVAO,
-    const glm::mat4 &view, const glm::mat4 &projection);
-void exportCBIN(std::vector<Frame> &frames, int delay, bool loop);
-void importCBIN(std::vector<Frame> &frames, int &delay, bool &loop);
+bool setupHeadlessRenderer(int width, int height);
+void destroyHeadlessRenderer();
+int runHeadless(int argc, char **argv);
+void mainLoop(Animation &animation);
+// Ask the idle main loop to draw at least `frames` more frames
+void requestRedraw(int frames = 3);
+void updateProjection();
+void updateCamera();
+void frameCamera(CubeSize size);
+void drawScene(const Frame &frame, int frameIndex, int mode);
+void markVoxelDirty(int index);
+void markFrameDirty();
+void uploadVoxelState(const Frame &frame, int frameIndex);
+void uploadPalette(const std::vector<uint32_t> &palette);
+void drawCube3D(const ShaderProgram &shader, GLuint cubeVAO);
+void updateSolidMesh(const Frame &frame);
+void drawSolid(const ShaderProgram &shader);
+void drawRaymarch(const ShaderProgram &shader);
+// Told the share of a file operation done so far, from 0 to 1; returning
+// false cancels it and leaves the file or animation as it was
+using FileProgress = std::function<bool(float)>;
+
+// The dialog functions return false when no file was chosen or it failed.
+// Version 2 compresses frames, see cbin_stream.h.
+bool exportCBIN(const Animation &animation, int version = 1, const FileProgress &progress = nullptr);
+bool importCBIN(Animation &animation, const FileProgress &progress = nullptr);
+bool writeCBIN(const char *path, const Animation &animation, int version = 1, const FileProgress &progress = nullptr);
+// Maps the file; its frames are only decoded once something looks at them. A
+// truncated or corrupt file is refused whole and leaves `animation` alone.
+bool mapCBIN(const char *path, Animation &animation, const FileProgress &progress = nullptr);
+bool exportBAM(const Animation &animation, const FileProgress &progress = nullptr);
+bool writeBAM(const char *path, const Animation &animation, const FileProgress &progress = nullptr);
 
 #endif
\ No newline at end of file
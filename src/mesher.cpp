@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cstdlib>
+#include "mesher.h"
+
+// Brightness of the voxel at p, 0 outside the cube
+static int lit(const Frame &frame, const int p[3])
+{
+    const CubeSize &size = frame.size;
+    if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= size.x || p[1] >= size.y || p[2] >= size.z)
+        return 0;
+    return frame.value(p[0], p[1], p[2]);
+}
+
+static void emitQuad(std::vector<MeshVertex> &out, int d, int u, int v, int plane, int i, int j,
+                     int w, int h, int sign, int value)
+{
+    float corners[4][3];
+    const int du[4] = {0, w, w, 0};
+    const int dv[4] = {0, 0, h, h};
+    for (int c = 0; c < 4; ++c)
+    {
+        corners[c][d] = plane - 0.5f;
+        corners[c][u] = i + du[c] - 0.5f;
+        corners[c][v] = j + dv[c] - 0.5f;
+    }
+    float normal[3] = {0.0f, 0.0f, 0.0f};
+    normal[d] = (float)sign;
+
+    // Counter-clockwise seen from the side the normal points to
+    static const int front[6] = {0, 1, 2, 2, 3, 0};
+    static const int back[6] = {0, 3, 2, 2, 1, 0};
+    const int *order = sign > 0 ? front : back;
+    for (int k = 0; k < 6; ++k)
+    {
+        const float *c = corners[order[k]];
+        out.push_back({c[0], c[1], c[2], normal[0], normal[1], normal[2], (float)value});
+    }
+}
+
+void meshRegion(const Frame &frame, const int lo[3], const int hi[3], std::vector<MeshVertex> &out)
+{
+    out.clear();
+    std::vector<int16_t> mask; // brightness of the face, negated for -d faces
+    for (int d = 0; d < 3; ++d)
+    {
+        int u = (d + 1) % 3, v = (d + 2) % 3;
+        int width = hi[u] - lo[u], height = hi[v] - lo[v];
+        mask.assign(width * height, 0);
+
+        // Plane s separates voxel s - 1 from voxel s along d. A face belongs to
+        // the region holding its lit voxel, so planes lo..hi cover all of them.
+        for (int s = lo[d]; s <= hi[d]; ++s)
+        {
+            bool any = false;
+            int p[3], q[3];
+            for (int j = 0; j < height; ++j)
+            {
+                for (int i = 0; i < width; ++i)
+                {
+                    p[d] = s - 1;
+                    p[u] = lo[u] + i;
+                    p[v] = lo[v] + j;
+                    q[d] = s;
+                    q[u] = p[u];
+                    q[v] = p[v];
+                    int back = s > lo[d] ? lit(frame, p) : 0;
+                    int front = s < hi[d] ? lit(frame, q) : 0;
+                    int16_t face = 0;
+                    if (back && !lit(frame, q))
+                        face = (int16_t)back; // +d face of voxel s - 1
+                    else if (front && !lit(frame, p))
+                        face = (int16_t)-front; // -d face of voxel s
+                    mask[j * width + i] = face;
+                    any |= face != 0;
+                }
+            }
+            if (!any)
+                continue;
+
+            // Grow each face into the widest, then tallest, rectangle of equal faces
+            for (int j = 0; j < height; ++j)
+            {
+                for (int i = 0; i < width;)
+                {
+                    int16_t face = mask[j * width + i];
+                    if (!face)
+                    {
+                        ++i;
+                        continue;
+                    }
+                    int w = 1;
+                    while (i + w < width && mask[j * width + i + w] == face)
+                        ++w;
+                    int h = 1;
+                    for (; j + h < height; ++h)
+                    {
+                        int k = 0;
+                        while (k < w && mask[(j + h) * width + i + k] == face)
+                            ++k;
+                        if (k < w)
+                            break;
+                    }
+                    for (int jj = j; jj < j + h; ++jj)
+                        std::fill(mask.begin() + jj * width + i, mask.begin() + jj * width + i + w, 0);
+
+                    emitQuad(out, d, u, v, s, lo[u] + i, lo[v] + j, w, h, face > 0 ? 1 : -1, std::abs(face));
+                    i += w;
+                }
+            }
+        }
+    }
+}
+
+void VoxelMesher::markChunk(int cx, int cy, int cz)
+{
+    if (cx < 0 || cy < 0 || cz < 0 || cx >= chunksX || cy >= chunksY || cz >= chunksZ)
+        return;
+    dirty[(cz * chunksY + cy) * chunksX + cx] = 1;
+}
+
+// A voxel on a chunk border also decides the visibility of the neighbour's faces
+void VoxelMesher::markVoxel(int x, int y, int z)
+{
+    int cx = x / MESH_CHUNK_SIZE, cy = y / MESH_CHUNK_SIZE, cz = z / MESH_CHUNK_SIZE;
+    markChunk(cx, cy, cz);
+    if (x % MESH_CHUNK_SIZE == 0)
+        markChunk(cx - 1, cy, cz);
+    if (x % MESH_CHUNK_SIZE == MESH_CHUNK_SIZE - 1)
+        markChunk(cx + 1, cy, cz);
+    if (y % MESH_CHUNK_SIZE == 0)
+        markChunk(cx, cy - 1, cz);
+    if (y % MESH_CHUNK_SIZE == MESH_CHUNK_SIZE - 1)
+        markChunk(cx, cy + 1, cz);
+    if (z % MESH_CHUNK_SIZE == 0)
+        markChunk(cx, cy, cz - 1);
+    if (z % MESH_CHUNK_SIZE == MESH_CHUNK_SIZE - 1)
+        markChunk(cx, cy, cz + 1);
+}
+
+const std::vector<int> &VoxelMesher::update(const Frame &frame)
+{
+    rebuilt.clear();
+    if (!valid || frame.size != size || frame.depth != depth)
+    {
+        size = frame.size;
+        depth = frame.depth;
+        chunksX = (size.x + MESH_CHUNK_SIZE - 1) / MESH_CHUNK_SIZE;
+        chunksY = (size.y + MESH_CHUNK_SIZE - 1) / MESH_CHUNK_SIZE;
+        chunksZ = (size.z + MESH_CHUNK_SIZE - 1) / MESH_CHUNK_SIZE;
+        chunks.assign(chunksX * chunksY * chunksZ, {});
+        dirty.assign(chunks.size(), 1);
+        meshed.assign(frame.planeWords() * depth, 0);
+        for (size_t i = 0; i < meshed.size(); ++i)
+            meshed[i] = frame.word(i);
+        valid = true;
+    }
+    else
+    {
+        // Unchanged words cost one compare; changed bits are located from the XOR
+        int bricksX = Frame::bricks(size.x), bricksY = Frame::bricks(size.y);
+        size_t planeWords = frame.planeWords();
+        for (size_t b = 0; b < frame.brickCount(); ++b)
+        {
+            const uint64_t *brick = frame.brickData(b);
+            int bx = (int)(b % bricksX), by = (int)(b / bricksX % bricksY), bz = (int)(b / bricksX / bricksY);
+            for (int plane = 0; plane < depth; ++plane)
+            {
+                for (int lz = 0; lz < 8; ++lz)
+                {
+                    uint64_t &was = meshed[plane * planeWords + b * 8 + lz];
+                    uint64_t now = brick ? brick[plane * 8 + lz] : 0;
+                    uint64_t changed = now ^ was;
+                    if (!changed)
+                        continue;
+                    was = now;
+                    while (changed)
+                    {
+                        int bit = ctz64(changed);
+                        changed &= changed - 1;
+                        markVoxel(bx * 8 + (bit & 7), by * 8 + (bit >> 3), bz * 8 + lz);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int cz = 0; cz < chunksZ; ++cz)
+    {
+        for (int cy = 0; cy < chunksY; ++cy)
+        {
+            for (int cx = 0; cx < chunksX; ++cx)
+            {
+                int chunk = (cz * chunksY + cy) * chunksX + cx;
+                if (!dirty[chunk])
+                    continue;
+                int lo[3] = {cx * MESH_CHUNK_SIZE, cy * MESH_CHUNK_SIZE, cz * MESH_CHUNK_SIZE};
+                int hi[3] = {std::min(lo[0] + MESH_CHUNK_SIZE, size.x),
+                             std::min(lo[1] + MESH_CHUNK_SIZE, size.y),
+                             std::min(lo[2] + MESH_CHUNK_SIZE, size.z)};
+                meshRegion(frame, lo, hi, chunks[chunk]);
+                dirty[chunk] = 0;
+                rebuilt.push_back(chunk);
+            }
+        }
+    }
+    return rebuilt;
+}
+
+size_t VoxelMesher::vertexCount() const
+{
+    size_t count = 0;
+    for (const auto &chunk : chunks)
+        count += chunk.size();
+    return count;
+}
\ No newline at end of file
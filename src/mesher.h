@@ -0,0 +1,52 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_MESHER_H_
+#define _LEDCUBEEDITOR_MESHER_H_
+
+#include <cstddef>
+#include <vector>
+#include "frame.h"
+
+constexpr int MESH_CHUNK_SIZE = 16;
+
+struct MeshVertex
+{
+    float x, y, z;
+    float nx, ny, nz;
+    float value; // brightness of the voxel the face belongs to
+};
+
+// Greedy mesh of the lit voxels inside [lo, hi) of `frame`: faces shared by
+// two lit voxels are dropped and coplanar faces of equal brightness are merged
+// into rectangles.
+// Voxels are unit cubes centered on their integer coordinates.
+void meshRegion(const Frame &frame, const int lo[3], const int hi[3], std::vector<MeshVertex> &out);
+
+// Solid display geometry, split in MESH_CHUNK_SIZE^3 chunks so an edit or a
+// frame switch only re-meshes the chunks whose voxels actually changed
+class VoxelMesher
+{
+public:
+    // Bring the mesh in line with `frame`, returns the chunks that were rebuilt
+    const std::vector<int> &update(const Frame &frame);
+    void invalidate() { valid = false; }
+
+    int chunkCount() const { return (int)chunks.size(); }
+    const std::vector<MeshVertex> &chunkVertices(int chunk) const { return chunks[chunk]; }
+    size_t vertexCount() const;
+    int maxValue() const { return (1 << depth) - 1; }
+
+private:
+    void markChunk(int cx, int cy, int cz);
+    void markVoxel(int x, int y, int z);
+
+    bool valid = false;
+    CubeSize size;
+    int depth = 1;
+    int chunksX = 0, chunksY = 0, chunksZ = 0;
+    std::vector<uint64_t> meshed; // frame bits the current mesh was built from
+    std::vector<std::vector<MeshVertex>> chunks;
+    std::vector<uint8_t> dirty;
+    std::vector<int> rebuilt;
+};
+
+#endif
\ No newline at end of file
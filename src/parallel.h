@@ -0,0 +1,46 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_PARALLEL_H_
+#define _LEDCUBEEDITOR_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Run body(i) for every i in [0, count) on up to one thread per core. Work is
+// handed out in chunks of `grain` indices; the calling thread takes part.
+template <typename Body>
+void parallelFor(size_t count, Body body, size_t grain = 16)
+{
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    size_t threads = std::min(cores, (count + grain - 1) / grain);
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            size_t begin = next.fetch_add(grain);
+            if (begin >= count)
+                return;
+            size_t end = std::min(begin + grain, count);
+            for (size_t i = begin; i < end; ++i)
+                body(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &thread : pool)
+        thread.join();
+}
+
+#endif
\ No newline at end of file
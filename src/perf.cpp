@@ -0,0 +1,174 @@
+#include <glad/glad.h>
+#include <imgui.h>
+#include <algorithm>
+#include <vector>
+#include "perf.h"
+
+constexpr int PERF_HISTORY = 240;  // frames kept for histograms and percentiles
+constexpr int PERF_GPU_LATENCY = 4; // frames a timer query may take to resolve
+
+static const char *metricNames[PERF_METRIC_COUNT] = {
+    "CPU frame", "Input", "UI build", "Scene (CPU)", "UI render (CPU)", "Swap",
+    "Import", "Export", "Scene (GPU)", "UI render (GPU)"};
+static const char *counterNames[PERF_COUNTER_COUNT] = {"Draw calls", "Uniform uploads", "Upload bytes"};
+
+// Fixed-size ring of samples, oldest first from `next`
+struct PerfHistory
+{
+    float samples[PERF_HISTORY] = {};
+    int next = 0;
+    int count = 0;
+
+    void push(float value)
+    {
+        samples[next] = value;
+        next = (next + 1) % PERF_HISTORY;
+        count = std::min(count + 1, PERF_HISTORY);
+    }
+    float last() const { return count ? samples[(next + PERF_HISTORY - 1) % PERF_HISTORY] : 0.0f; }
+};
+
+static PerfHistory metricHistory[PERF_METRIC_COUNT];
+static PerfHistory counterHistory[PERF_COUNTER_COUNT];
+static double frameTimes[PERF_METRIC_COUNT];
+static bool frameTouched[PERF_METRIC_COUNT];
+static int frameCounts[PERF_COUNTER_COUNT];
+
+struct GpuQuery
+{
+    GLuint id = 0;
+    PerfMetric metric = PERF_GPU_SCENE;
+    bool pending = false;
+};
+static GpuQuery gpuQueries[PERF_GPU_LATENCY][2];
+static int gpuFrame = 0;
+static int gpuQueryIndex = 0;
+static bool gpuTimersSupported = false;
+
+void perfInit()
+{
+    // Timer queries are core since GL 3.3
+    gpuTimersSupported = GLAD_GL_VERSION_3_3 != 0;
+    if (!gpuTimersSupported)
+        return;
+    for (auto &frame : gpuQueries)
+        for (auto &query : frame)
+            glGenQueries(1, &query.id);
+}
+
+void perfShutdown()
+{
+    if (!gpuTimersSupported)
+        return;
+    for (auto &frame : gpuQueries)
+        for (auto &query : frame)
+            glDeleteQueries(1, &query.id);
+}
+
+void perfBeginFrame()
+{
+    std::fill(std::begin(frameTimes), std::end(frameTimes), 0.0);
+    std::fill(std::begin(frameTouched), std::end(frameTouched), false);
+    std::fill(std::begin(frameCounts), std::end(frameCounts), 0);
+
+    if (!gpuTimersSupported)
+        return;
+    // Reuse the oldest slot: collect its results if the GPU is done with
+    // them, otherwise drop them rather than stall the pipeline
+    gpuFrame = (gpuFrame + 1) % PERF_GPU_LATENCY;
+    gpuQueryIndex = 0;
+    for (auto &query : gpuQueries[gpuFrame])
+    {
+        if (!query.pending)
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &ns);
+            metricHistory[query.metric].push((float)(ns / 1.0e6));
+        }
+        query.pending = false;
+    }
+}
+
+void perfEndFrame()
+{
+    for (int i = 0; i < PERF_METRIC_COUNT; ++i)
+        if (frameTouched[i])
+            metricHistory[i].push((float)frameTimes[i]);
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        counterHistory[i].push((float)frameCounts[i]);
+}
+
+void perfAddTime(PerfMetric metric, double ms)
+{
+    frameTimes[metric] += ms;
+    frameTouched[metric] = true;
+}
+
+void perfCount(PerfCounter counter, int amount)
+{
+    frameCounts[counter] += amount;
+}
+
+void perfGpuBegin(PerfMetric metric)
+{
+    if (!gpuTimersSupported || gpuQueryIndex >= 2)
+        return;
+    GpuQuery &query = gpuQueries[gpuFrame][gpuQueryIndex];
+    query.metric = metric;
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+}
+
+void perfGpuEnd()
+{
+    if (!gpuTimersSupported || gpuQueryIndex >= 2)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuQueries[gpuFrame][gpuQueryIndex++].pending = true;
+}
+
+static float percentile(std::vector<float> &sorted, float p)
+{
+    if (sorted.empty())
+        return 0.0f;
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5f));
+    return sorted[index];
+}
+
+static void plotHistory(const char *label, const PerfHistory &history, const char *unit)
+{
+    std::vector<float> sorted(history.samples, history.samples + history.count);
+    std::sort(sorted.begin(), sorted.end());
+    float p50 = percentile(sorted, 0.50f), p95 = percentile(sorted, 0.95f), p99 = percentile(sorted, 0.99f);
+
+    ImGui::Text("%-16s %8.2f %s  p50 %.2f  p95 %.2f  p99 %.2f", label, history.last(), unit, p50, p95, p99);
+    int offset = history.count < PERF_HISTORY ? 0 : history.next;
+    ImGui::PushID(label);
+    ImGui::PlotHistogram("", history.samples, history.count, offset, nullptr, 0.0f,
+                         sorted.empty() ? 1.0f : std::max(sorted.back(), 1e-3f), ImVec2(320, 32));
+    ImGui::PopID();
+}
+
+void drawPerfHud(bool *open)
+{
+    ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.75f);
+    if (!ImGui::Begin("Performance", open, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing))
+    {
+        ImGui::End();
+        return;
+    }
+    ImGui::Text("Last %d drawn frames", PERF_HISTORY);
+    if (!gpuTimersSupported)
+        ImGui::TextDisabled("GPU timer queries unavailable");
+    for (int i = 0; i < PERF_METRIC_COUNT; ++i)
+        if (metricHistory[i].count)
+            plotHistory(metricNames[i], metricHistory[i], "ms");
+    ImGui::Separator();
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        plotHistory(counterNames[i], counterHistory[i], "");
+    ImGui::End();
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_PERF_H_
+#define _LEDCUBEEDITOR_PERF_H_
+
+#include <chrono>
+
+// Timed sections. CPU ones are measured with PerfScope, GPU ones with GL
+// timer queries between perfGpuBegin and perfGpuEnd.
+enum PerfMetric
+{
+    PERF_CPU_FRAME,
+    PERF_CPU_INPUT,
+    PERF_CPU_UI_BUILD,
+    PERF_CPU_SCENE,
+    PERF_CPU_UI_RENDER,
+    PERF_CPU_SWAP,
+    PERF_CPU_IMPORT,
+    PERF_CPU_EXPORT,
+    PERF_GPU_SCENE,
+    PERF_GPU_UI,
+    PERF_METRIC_COUNT
+};
+
+// Per-frame event counts
+enum PerfCounter
+{
+    PERF_DRAW_CALLS,
+    PERF_UNIFORM_UPLOADS,
+    PERF_UPLOAD_BYTES,
+    PERF_COUNTER_COUNT
+};
+
+void perfInit();
+void perfShutdown();
+void perfBeginFrame();
+void perfEndFrame();
+void perfAddTime(PerfMetric metric, double ms);
+void perfCount(PerfCounter counter, int amount = 1);
+void perfGpuBegin(PerfMetric metric);
+void perfGpuEnd();
+void drawPerfHud(bool *open);
+
+inline double perfElapsedMs(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+struct PerfScope
+{
+    explicit PerfScope(PerfMetric metric) : metric(metric), start(std::chrono::steady_clock::now()) {}
+    ~PerfScope()
+    {
+        auto end = std::chrono::steady_clock::now();
+        perfAddTime(metric, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    PerfScope(const PerfScope &) = delete;
+    PerfScope &operator=(const PerfScope &) = delete;
+
+    PerfMetric metric;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
\ No newline at end of file
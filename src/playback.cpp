@@ -0,0 +1,58 @@
+#include <algorithm>
+#include "playback.h"
+
+int Playback::step(int frame, int direction, int frameCount, bool loop)
+{
+    running = false;
+    frame += direction;
+    if (loop)
+        return (frame % frameCount + frameCount) % frameCount;
+    return std::clamp(frame, 0, frameCount - 1);
+}
+
+bool Playback::update(int &frame, int frameCount, int delayMs, bool loop)
+{
+    if (!running || frameCount <= 0)
+        return false;
+    auto now = Clock::now();
+    auto period = std::chrono::milliseconds(std::max(delayMs, 1));
+    if (nextDue == Clock::time_point())
+    {
+        nextDue = now + period;
+        return false;
+    }
+    if (now < nextDue)
+        return false;
+
+    // Every frame due since the last update; all but the newest were never shown
+    long long due = (now - nextDue) / period + 1;
+    auto shownDue = nextDue + (due - 1) * period;
+    nextDue += due * period;
+    dropped += due - 1;
+    ++shown;
+
+    double lateness = std::chrono::duration<double, std::milli>(now - shownDue).count();
+    worstLateness = std::max(worstLateness, lateness);
+    if (lateness > std::max(1.0, delayMs * 0.5))
+        ++late;
+
+    long long next = frame + due;
+    if (next >= frameCount)
+    {
+        if (!loop)
+        {
+            frame = frameCount - 1;
+            running = false;
+            return true;
+        }
+        next %= frameCount;
+    }
+    frame = (int)next;
+    return true;
+}
+
+void Playback::resetStats()
+{
+    shown = late = dropped = 0;
+    worstLateness = 0.0;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_PLAYBACK_H_
+#define _LEDCUBEEDITOR_PLAYBACK_H_
+
+#include <chrono>
+
+// Plays an animation on its own steady_clock schedule: frame k is due at
+// start + k * delay whatever the UI frame rate is. When the UI cannot present
+// every frame the schedule still advances, and skipped and late frames are
+// counted so the preview timing can be compared with the hardware.
+class Playback
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void play()
+    {
+        running = true;
+        resync();
+    }
+    void pause() { running = false; }
+    bool playing() const { return running; }
+    // Restart the schedule from the current frame, e.g. after the user scrubbed
+    void resync() { nextDue = Clock::time_point(); }
+    // Move one frame forward or back and pause
+    int step(int frame, int direction, int frameCount, bool loop);
+
+    // Advance to the frame due now. Returns true when the frame changed.
+    bool update(int &frame, int frameCount, int delayMs, bool loop);
+    // Time the next frame is due, only meaningful while playing
+    Clock::time_point nextFrameTime() const { return nextDue; }
+
+    void resetStats();
+    long long shownFrames() const { return shown; }
+    long long lateFrames() const { return late; }
+    long long droppedFrames() const { return dropped; }
+    double worstLatenessMs() const { return worstLateness; }
+
+private:
+    bool running = false;
+    Clock::time_point nextDue;
+    long long shown = 0, late = 0, dropped = 0;
+    double worstLateness = 0.0;
+};
+
+#endif
\ No newline at end of file
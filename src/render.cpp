@@ -10,20 +10,73 @@
 #include <chrono>
 #include <thread>
 #include <algorithm>
+#include <cstdlib>
 #include "main.h"
+#include "mesher.h"
+#include "frame_store.h"
+#include "history.h"
+#include "perf.h"
+#include "playback.h"
+#include "transform.h"
+#include "compositor.h"
+#include "tween.h"
+#include "file_job.h"
 
 glm::mat4 projection, view;
 glm::vec3 cameraPos, up, target;
 auto prevCameraPos = cameraPos;
-GLuint voxelShader;
+ShaderProgram voxelShader;
+ShaderProgram solidShader;
+ShaderProgram raymarchShader;
+GLuint cameraUBO;
+bool cameraDirty = true;
 GLuint cubeVAO, cubeVBO;
+GLuint voxelOffsetVBO;
+GLuint voxelBitsBuffer, voxelBitsTexture;
+GLuint paletteBuffer, paletteTexture;
+
 float cameraDistance = 4.5f;
+float sceneScale = 1.0f; // largest cube dimension relative to the default 8
+
+// CPU mirror of voxelBitsBuffer, the cube size and frame it was taken from and
+// the Frame::word() range edited since the last upload
+std::vector<uint64_t> gpuBits;
+CubeSize gpuSize;
+int gpuDepth = 1;
+int gpuFrame = -1;
+int dirtyBegin = 0, dirtyEnd = 0;
+const int uploadMergeGap = 2; // unchanged words tolerated inside one upload
+std::vector<uint32_t> gpuPalette;
+
+static void resizeVoxelBuffers(CubeSize size, int depth);
+static void createSceneResources();
+static void destroySceneResources();
+
+// Solid display mode: greedy-meshed lit voxels, one VAO/VBO per mesher chunk
+int displayMode = DISPLAY_LEDS;
+VoxelMesher solidMesher;
+std::vector<GLuint> solidVAOs, solidVBOs;
+std::vector<GLsizei> solidVertexCounts;
+
+// Ray-march display mode, reading the same voxel bits as the LED mode
+GLuint raymarchVAO;
 
 GLFWwindow *window;
 int display_w, display_h;
 
 const int target_fps = 60;
-const int frame_time_ms = 1000 / target_fps;
+const auto frame_period = std::chrono::nanoseconds(1000000000 / target_fps);
+const double idle_wait_s = 0.5; // longest sleep in idle mode
+
+// Frames left to draw before the loop goes idle and blocks on events.
+// ImGui needs a couple of frames after an input to settle hover/active state.
+int pendingRedraws = 3;
+bool uiInteracting = false;
+
+void requestRedraw(int frames)
+{
+    pendingRedraws = std::max(pendingRedraws, frames);
+}
 
 float cubeVertices[] = {
     // positions
@@ -76,18 +129,85 @@ void setupRenderer()
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1);
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    perfInit();
 
     glfwSetScrollCallback(window, [](GLFWwindow *, double xoffset, double yoffset)
                           {
                               ImGuiIO &io = ImGui::GetIO();
                               io.MouseWheelH += (float)xoffset; // horizontal scroll
                               io.MouseWheel += (float)yoffset;  // vertical scroll
+                              requestRedraw();
                           });
 
+    // Any input wakes the idle loop; ImGui chains these when it installs its own callbacks
+    glfwSetCursorPosCallback(window, [](GLFWwindow *, double, double)
+                             { requestRedraw(); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow *, int, int, int)
+                               { requestRedraw(); });
+    glfwSetKeyCallback(window, [](GLFWwindow *, int, int, int, int)
+                       { requestRedraw(); });
+    glfwSetCharCallback(window, [](GLFWwindow *, unsigned int)
+                        { requestRedraw(); });
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow *, int, int)
+                                   { requestRedraw(); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow *)
+                                 { requestRedraw(); });
+
     ImGui::CreateContext();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 130");
 
+    createSceneResources();
+
+    glfwGetFramebufferSize(window, &display_w, &display_h);
+
+    updateProjection();
+}
+
+// Offscreen context for batch rendering: no visible window, no ImGui. Without
+// a display server GLFW 3.4's null platform is used with an OSMesa context.
+bool setupHeadlessRenderer(int width, int height)
+{
+#ifdef GLFW_PLATFORM_NULL
+    if (!getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY"))
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    if (!glfwInit())
+        return false;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_PLATFORM_NULL
+    if (glfwGetPlatform() == GLFW_PLATFORM_NULL)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+    window = glfwCreateWindow(width, height, "LED Cube Editor (headless)", NULL, NULL);
+    if (!window)
+    {
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    perfInit();
+
+    createSceneResources();
+
+    display_w = width;
+    display_h = height;
+    updateProjection();
+    return true;
+}
+
+void destroyHeadlessRenderer()
+{
+    perfShutdown();
+    destroySceneResources();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
+
+// GL objects shared by the interactive and the headless renderer
+static void createSceneResources()
+{
     glGenVertexArrays(1, &cubeVAO);
     glGenBuffers(1, &cubeVBO);
 
@@ -97,59 +217,219 @@ void setupRenderer()
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+
+    // Per-voxel offsets only change with the cube size, so they live in a
+    // static instance buffer filled by resizeVoxelBuffers
+    glGenBuffers(1, &voxelOffsetVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, voxelOffsetVBO);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+    glVertexAttribDivisor(1, 1);
+
     glBindVertexArray(0);
 
+    // On/off state is the dense Frame::word() layout, exposed to the shaders as
+    // a buffer texture of (low, high) word halves and patched by uploadVoxelState
+    glGenBuffers(1, &voxelBitsBuffer);
+    glGenTextures(1, &voxelBitsTexture);
+
+    // RGB cube palette, one RGBA8 texel per entry, replaced by uploadPalette
+    const uint8_t noColor[4] = {0, 0, 0, 255};
+    glGenBuffers(1, &paletteBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, paletteBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(noColor), noColor, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glGenTextures(1, &paletteTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, paletteBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    gpuPalette.clear();
+
+    resizeVoxelBuffers(gpuSize, gpuDepth);
+
     glEnable(GL_DEPTH_TEST);
 
-    voxelShader = LoadShaderProgram("shaders/vertex.glsl", "shaders/fragment.glsl");
+    voxelShader.load("shaders/vertex.glsl", "shaders/fragment.glsl");
+    solidShader.load("shaders/solid_vertex.glsl", "shaders/solid_fragment.glsl");
+    raymarchShader.load("shaders/raymarch_vertex.glsl", "shaders/raymarch_fragment.glsl");
+
+    glGenVertexArrays(1, &raymarchVAO); // the full-screen pass has no attributes
+
+    // Shared by every program that declares the "Camera" uniform block
+    glGenBuffers(1, &cameraUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUBO);
+    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_UBO_BINDING, cameraUBO);
 
     cameraPos = glm::vec3(-20.0f, 4.5f, cameraDistance);
     target = glm::vec3(4.5f, 4.5f, 4.5f); // center of 8x8x8 cube
     up = glm::vec3(0.0f, 0.0f, 1.0f);
 
     view = glm::lookAt(cameraPos, target, up);
+}
 
-    glfwGetFramebufferSize(window, &display_w, &display_h);
+static void destroySceneResources()
+{
+    glDeleteVertexArrays(1, &cubeVAO);
+    glDeleteBuffers(1, &cubeVBO);
+    glDeleteBuffers(1, &voxelOffsetVBO);
+    glDeleteBuffers(1, &voxelBitsBuffer);
+    glDeleteTextures(1, &voxelBitsTexture);
+    glDeleteBuffers(1, &paletteBuffer);
+    glDeleteTextures(1, &paletteTexture);
+    glDeleteBuffers(1, &cameraUBO);
+    voxelShader.destroy();
+    solidShader.destroy();
+    raymarchShader.destroy();
+    glDeleteVertexArrays(1, &raymarchVAO);
+    glDeleteVertexArrays((GLsizei)solidVAOs.size(), solidVAOs.data());
+    glDeleteBuffers((GLsizei)solidVBOs.size(), solidVBOs.data());
+}
+
+// Reallocate the instance offsets and the voxel bits for a new cube size or depth
+static void resizeVoxelBuffers(CubeSize size, int depth)
+{
+    std::vector<glm::vec3> offsets;
+    offsets.reserve(size.count());
+    for (int z = 0; z < size.z; ++z)
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+                offsets.emplace_back(x, y, z);
 
+    glBindBuffer(GL_ARRAY_BUFFER, voxelOffsetVBO);
+    glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), offsets.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    gpuBits.assign(Frame::wordCount(size) * depth, 0);
+    gpuSize = size;
+    gpuDepth = depth;
+    gpuFrame = -1;
+    dirtyBegin = dirtyEnd = 0;
+    glBindBuffer(GL_TEXTURE_BUFFER, voxelBitsBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, gpuBits.size() * sizeof(uint64_t), gpuBits.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, voxelBitsTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, voxelBitsBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+// Re-center the camera on a cube of the given size, keeping the view direction
+void frameCamera(CubeSize size)
+{
+    sceneScale = std::max({size.x, size.y, size.z}) / (float)DEFAULT_CUBE_SIZE;
+    glm::vec3 direction = glm::normalize(cameraPos - target);
+    target = glm::vec3(size.x, size.y, size.z) * 0.5f + glm::vec3(0.5f);
+    cameraPos = target + direction * 24.5f * sceneScale; // default 8x8x8 view distance
+    view = glm::lookAt(cameraPos, target, up);
+    updateProjection();
+}
+
+void updateProjection()
+{
     float fov = glm::radians(45.0f); // Field of view
-    float aspect = (float)display_w / (float)display_h;
+    float aspect = display_h > 0 ? (float)display_w / (float)display_h : 1.0f;
     float near = 0.1f;
-    float far = 100.0f;
+    float far = 100.0f * std::max(1.0f, sceneScale);
 
     projection = glm::perspective(fov, aspect, near, far);
+    cameraDirty = true;
+}
+
+// Upload view and projection to the camera UBO, only when they changed
+void updateCamera()
+{
+    if (!cameraDirty)
+        return;
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(view));
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(projection));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    perfCount(PERF_UNIFORM_UPLOADS, 2);
+    perfCount(PERF_UPLOAD_BYTES, 2 * sizeof(glm::mat4));
+    cameraDirty = false;
 }
 
 void destroyRenderer()
 {
+    perfShutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
+    destroySceneResources();
     glfwDestroyWindow(window);
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteProgram(voxelShader);
     glfwTerminate();
 }
 
+static ImVec4 paletteColor(uint32_t rgb)
+{
+    return ImVec4(((rgb >> 16) & 0xff) / 255.0f, ((rgb >> 8) & 0xff) / 255.0f, (rgb & 0xff) / 255.0f, 1.0f);
+}
+
 bool rightDragging = false;
 bool wheelDragging = false;
 
 int currentFrame = 0;
-int delay = 100;
-bool loop = true;
 int editLayer = 0; // Z layer
+int brushValue = 1; // brightness painted by the matrix editor
+int strokeValue = -1; // value painted by the current drag stroke, -1 between strokes
+EditHistory history;
+int undoBudgetKB = 256;
+int rangeLength = 1; // frames affected by the timeline range operations
+int moveTarget = 0;
+Compositor compositor; // what the scene shows once layers exist
+int activeLayer = 0; // layer the matrix editor paints, 0 for the animation's own frames
+Transform transform; // settings of the Transform section
+double transformMs = 0.0;
+Tween tween;
+TweenSettings tweenSettings;
+bool tweenPreview = false;
+int tweenPreviewFrame = 0; // in-between shown by the preview
 bool showMatrixEditor = true;
+bool showPerfHud = false;
+bool compressExport = false; // write .cbin v2 for controllers short on flash
+FileJob fileJob; // import or export running in the background
+Playback playback;
+int sizeInput[3] = {DEFAULT_CUBE_SIZE, DEFAULT_CUBE_SIZE, DEFAULT_CUBE_SIZE};
 
 
-void mainLoop(std::vector <Frame> &frames)
+void mainLoop(Animation &animation)
 {
+    auto &frames = animation.frames;
+
     while (!glfwWindowShouldClose(window))
     {
-        auto start = std::chrono::high_resolution_clock::now();
-        glfwPollEvents();
+        // Redraw continuously only while the user drags the camera or a widget,
+        // otherwise block until an event or a dirty flag asks for a frame
+        bool continuous = rightDragging || wheelDragging || uiInteracting;
+        if (continuous || pendingRedraws > 0)
+            glfwPollEvents();
+        else if (playback.playing())
+        {
+            // Sleep until the next animation frame is due unless input comes first
+            auto wait = std::chrono::duration<double>(playback.nextFrameTime() - std::chrono::steady_clock::now());
+            glfwWaitEventsTimeout(std::clamp(wait.count(), 0.0, idle_wait_s));
+        }
+        else
+            glfwWaitEventsTimeout(idle_wait_s);
+
+        if (playback.update(currentFrame, (int)frames.size(), animation.delay, animation.loop))
+            requestRedraw(1);
 
         auto &IO = ImGui::GetIO();
 
+        if (!continuous && pendingRedraws == 0)
+        {
+            if (!IO.WantTextInput)
+                continue;
+            requestRedraw(1); // keep the text cursor blinking
+        }
+        if (pendingRedraws > 0)
+            --pendingRedraws;
+
+        auto start = std::chrono::steady_clock::now();
+        perfBeginFrame();
+
         if (!IO.WantCaptureMouse)
         {
             if (IO.MouseDown[ImGuiMouseButton_Right])
@@ -183,7 +463,7 @@ void mainLoop(std::vector <Frame> &frames)
 
                     // 6. Update view matrix
                     view = glm::lookAt(cameraPos, target, up);
-                    glUniformMatrix4fv(glGetUniformLocation(voxelShader, "view"), 1, GL_FALSE, glm::value_ptr(view));
+                    cameraDirty = true;
                 }
                 else
                 {
@@ -199,11 +479,10 @@ void mainLoop(std::vector <Frame> &frames)
             {
                 cameraDistance = glm::length(cameraPos - target);
                 cameraDistance -= IO.MouseWheel * 1.0f; // Change zoom speed here
-                cameraDistance = std::clamp(cameraDistance, 5.0f, 100.0f);
+                cameraDistance = std::clamp(cameraDistance, 5.0f, 100.0f * std::max(1.0f, sceneScale));
                 cameraPos = glm::normalize(cameraPos - target) * cameraDistance + target; // Recalculate camera position
                 view = glm::lookAt(cameraPos, target, up);
-                // Update the view matrix
-                glUniformMatrix4fv(glGetUniformLocation(voxelShader, "view"), 1, GL_FALSE, glm::value_ptr(view));
+                cameraDirty = true;
             }
 
             if (IO.MouseDown[ImGuiMouseButton_Middle])
@@ -228,7 +507,7 @@ void mainLoop(std::vector <Frame> &frames)
                     target += panMovement;
 
                     view = glm::lookAt(cameraPos, target, up);
-                    glUniformMatrix4fv(glGetUniformLocation(voxelShader, "view"), 1, GL_FALSE, glm::value_ptr(view));
+                    cameraDirty = true;
                 }
                 else
                 {
@@ -242,43 +521,576 @@ void mainLoop(std::vector <Frame> &frames)
             }
         }
 
+        perfAddTime(PERF_CPU_INPUT, perfElapsedMs(start));
+
+        auto uiStart = std::chrono::steady_clock::now();
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
         // UI
+        bool showTween = false;
         ImGui::Begin("LED Cube Controls");
         if (ImGui::Button("Add Frame"))
-            frames.emplace_back();
+        {
+            frames.push_back(FrameHandle(Frame(animation.size, animation.depth)));
+            frames.back().intern();
+            requestRedraw();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Insert Frame"))
+        {
+            FrameHandle blank(Frame(animation.size, animation.depth));
+            blank.intern();
+            frames.insert(currentFrame + 1, std::move(blank));
+            history.framesInserted(currentFrame + 1, 1);
+            compositor.invalidateFrom(currentFrame + 1);
+            ++currentFrame;
+            playback.resync();
+            markFrameDirty();
+            requestRedraw();
+        }
+
+        // Timeline edits act on the range of frames starting at the current one
+        int frameCount = (int)frames.size();
+        rangeLength = std::clamp(rangeLength, 1, frameCount - currentFrame);
+        ImGui::InputInt("Range Length", &rangeLength);
+        rangeLength = std::clamp(rangeLength, 1, frameCount - currentFrame);
+        bool timelineChanged = false;
+        if (ImGui::Button("Duplicate Range"))
+        {
+            // The copies share contents until one of them is edited
+            frames.duplicate(currentFrame, rangeLength);
+            history.framesInserted(currentFrame + rangeLength, rangeLength);
+            compositor.invalidateFrom(currentFrame + rangeLength);
+            currentFrame += rangeLength;
+            timelineChanged = true;
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(rangeLength >= frameCount);
+        if (ImGui::Button("Delete Range"))
+        {
+            frames.erase(currentFrame, rangeLength);
+            history.framesRemoved(currentFrame, rangeLength);
+            compositor.invalidateFrom(currentFrame);
+            currentFrame = std::min(currentFrame, (int)frames.size() - 1);
+            timelineChanged = true;
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        if (ImGui::Button("Move Range To"))
+        {
+            moveTarget = std::clamp(moveTarget, 0, frameCount - rangeLength);
+            frames.move(currentFrame, rangeLength, moveTarget);
+            history.framesMoved(currentFrame, rangeLength, moveTarget);
+            compositor.invalidateFrom(std::min(currentFrame, moveTarget));
+            currentFrame = moveTarget;
+            timelineChanged = true;
+        }
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(80.0f);
+        ImGui::InputInt("##moveTarget", &moveTarget, 0);
+        if (timelineChanged)
+        {
+            playback.resync();
+            markFrameDirty();
+            requestRedraw();
+        }
+        // Dialogs and file work run on fileJob's thread; only the copy of the
+        // animation for an export and swapping an import in happen here
+        ImGui::BeginDisabled(fileJob.busy());
         if (ImGui::Button("Export .cbin"))
-            exportCBIN(frames, delay, loop);
+            fileJob.start(FILE_JOB_EXPORT_CBIN, animation.layers.empty() ? animation : compositor.flatten(animation),
+                          compressExport ? 2 : 1);
+        ImGui::SameLine();
+        ImGui::Checkbox("Compress (v2)", &compressExport);
+        if (animation.depth > 1 || !animation.palette.empty())
+        {
+            ImGui::SameLine();
+            if (ImGui::Button("Export BAM"))
+                fileJob.start(FILE_JOB_EXPORT_BAM, animation.layers.empty() ? animation : compositor.flatten(animation));
+        }
         if (ImGui::Button("Import .cbin"))
-            importCBIN(frames, delay, loop);
-        ImGui::SliderInt("Current Frame", &currentFrame, 0, frames.size() - 1);
-        ImGui::InputInt("Delay (ms)", &delay);
-        ImGui::Checkbox("Loop", &loop);
+            fileJob.start(FILE_JOB_IMPORT_CBIN);
+        ImGui::EndDisabled();
+        if (fileJob.busy())
+        {
+            ImGui::ProgressBar(fileJob.progress(), ImVec2(-80.0f, 0.0f), fileJob.label().c_str());
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel"))
+                fileJob.cancel();
+            requestRedraw(1); // keep the bar moving and notice the end
+        }
+        Animation imported;
+        if (fileJob.finish(imported))
+        {
+            CubeSize oldSize = animation.size;
+            animation = std::move(imported);
+            history.clear();
+            compositor.invalidateAll();
+            activeLayer = std::min(activeLayer, (int)animation.layers.size());
+            if (animation.size != oldSize)
+            {
+                frameCamera(animation.size);
+                sizeInput[0] = animation.size.x;
+                sizeInput[1] = animation.size.y;
+                sizeInput[2] = animation.size.z;
+            }
+            currentFrame = std::clamp(currentFrame, 0, (int)frames.size() - 1);
+            markFrameDirty();
+            requestRedraw();
+        }
+        if (ImGui::Button(playback.playing() ? "Pause" : "Play"))
+        {
+            if (playback.playing())
+            {
+                playback.pause();
+            }
+            else
+            {
+                playback.resetStats();
+                playback.play();
+            }
+            requestRedraw();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("<"))
+        {
+            currentFrame = playback.step(currentFrame, -1, (int)frames.size(), animation.loop);
+            requestRedraw();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button(">"))
+        {
+            currentFrame = playback.step(currentFrame, 1, (int)frames.size(), animation.loop);
+            requestRedraw();
+        }
+        if (playback.shownFrames())
+        {
+            ImGui::SameLine();
+            ImGui::Text("shown %lld, late %lld, dropped %lld (worst %.1f ms)", playback.shownFrames(),
+                        playback.lateFrames(), playback.droppedFrames(), playback.worstLatenessMs());
+        }
+        if (ImGui::SliderInt("Current Frame", &currentFrame, 0, frames.size() - 1))
+            playback.resync();
+        ImGui::InputInt("Delay (ms)", &animation.delay);
+        ImGui::Checkbox("Loop", &animation.loop);
+        ImGui::InputInt3("Size (X Y Z)", sizeInput);
+        const char *displayModes[] = {"LEDs", "Solid", "Ray march"};
+        if (ImGui::Combo("Display", &displayMode, displayModes, 3))
+            requestRedraw();
+        if (displayMode == DISPLAY_SOLID)
+            ImGui::Text("Solid mesh: %zu vertices", solidMesher.vertexCount());
+        bool rgb = !animation.palette.empty();
+        if (ImGui::Checkbox("RGB palette", &rgb))
+        {
+            // Voxel values carry over: brightness level v becomes palette entry v
+            animation.palette.clear();
+            history.clear();
+            if (rgb)
+            {
+                int maxValue = (1 << animation.depth) - 1;
+                animation.palette.push_back(0);
+                for (int v = 1; v <= maxValue; ++v)
+                {
+                    uint32_t level = 255 * v / maxValue;
+                    animation.palette.push_back((level / 5) << 16 | (level * 4 / 5) << 8 | level); // Cyan ramp
+                }
+            }
+            requestRedraw();
+        }
+        const char *depths[] = {"On/off", "4-bit", "8-bit"};
+        int depthItem = animation.depth == 8 ? 2 : animation.depth == 4 ? 1 : 0;
+        if (!rgb && ImGui::Combo("Brightness", &depthItem, depths, 3))
+        {
+            const int depthBits[] = {1, 4, 8};
+            int oldMax = (1 << animation.depth) - 1;
+            animation.setDepth(depthBits[depthItem]);
+            history.clear();
+            compositor.invalidateAll();
+            brushValue = std::max(1, brushValue * ((1 << animation.depth) - 1) / oldMax);
+            requestRedraw();
+        }
+        if (ImGui::Button("Resize Cube"))
+        {
+            CubeSize newSize{sizeInput[0], sizeInput[1], sizeInput[2]};
+            if (newSize.valid() && newSize != animation.size)
+            {
+                animation.resize(newSize);
+                history.clear();
+                compositor.invalidateAll();
+                frameCamera(newSize);
+                requestRedraw();
+            }
+        }
+        if (ImGui::Checkbox("Performance HUD", &showPerfHud))
+            requestRedraw();
+        if (ImGui::CollapsingHeader("Frame pool"))
+        {
+            FrameStoreStats stats = frameStoreStats(frames);
+            ImGui::Text("%zu frames, %zu unique, %zu pooled", stats.frames, stats.unique, framePool().entries());
+            ImGui::Text("%.1f KB stored, %.1f KB saved", stats.uniqueBytes / 1024.0, (stats.bytes - stats.uniqueBytes) / 1024.0);
+            if (stats.unloaded)
+                ImGui::Text("%zu frames still only in the mapped file", stats.unloaded);
+        }
+        if (ImGui::CollapsingHeader("Transform"))
+        {
+            // Acts on the same frame range as the timeline edits
+            const char *axes[] = {"X", "Y", "Z"};
+            ImGui::Combo("Axis", &transform.axis, axes, 3);
+            ImGui::InputInt("Shift By", &transform.amount);
+            ImGui::Checkbox("Wrap", &transform.wrap);
+            bool apply = false;
+            Transform chosen = transform;
+            if (ImGui::Button("Rotate 90"))
+            {
+                chosen.kind = TRANSFORM_ROTATE;
+                chosen.amount = 1;
+                apply = true;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Mirror"))
+            {
+                chosen.kind = TRANSFORM_MIRROR;
+                apply = true;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Shift"))
+            {
+                chosen.kind = TRANSFORM_SHIFT;
+                apply = true;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Scroll"))
+            {
+                chosen.kind = TRANSFORM_SHIFT;
+                chosen.scroll = true;
+                apply = true;
+            }
+            if (apply)
+            {
+                auto start = std::chrono::steady_clock::now();
+                CubeSize oldSize = animation.size;
+                history.beginRangeEdit(animation, currentFrame, rangeLength);
+                transformFrames(animation, currentFrame, rangeLength, chosen);
+                transformMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                history.endEdit(animation);
+                compositor.invalidateRange(currentFrame, rangeLength);
+                if (animation.size != oldSize)
+                {
+                    // Every frame changed size, so no word index still fits
+                    history.clear();
+                    compositor.invalidateAll();
+                    frameCamera(animation.size);
+                    sizeInput[0] = animation.size.x;
+                    sizeInput[1] = animation.size.y;
+                    sizeInput[2] = animation.size.z;
+                }
+                markFrameDirty();
+                requestRedraw();
+            }
+            if (transformMs > 0.0)
+                ImGui::Text("Last transform: %.2f ms", transformMs);
+        }
+        if (ImGui::CollapsingHeader("Tween"))
+        {
+            // The frames of the range are the keyframes, in-betweens go after each but the last
+            const char *tweenModes[] = {"Motion", "Morph", "Dissolve"};
+            const char *axes[] = {"X", "Y", "Z"};
+            int mode = tweenSettings.mode;
+            if (ImGui::Combo("Tween Mode", &mode, tweenModes, 3))
+                tweenSettings.mode = (TweenMode)mode;
+            ImGui::InputInt("In-betweens", &tweenSettings.steps);
+            tweenSettings.steps = std::clamp(tweenSettings.steps, 1, 64);
+            if (tweenSettings.mode == TWEEN_MOTION)
+            {
+                ImGui::Combo("Turn Axis", &tweenSettings.axis, axes, 3);
+                ImGui::SliderFloat("Turn (degrees)", &tweenSettings.angle, -360.0f, 360.0f);
+            }
+            else if (tweenSettings.mode == TWEEN_DISSOLVE)
+            {
+                const char *orders[] = {"Random", "Sweep", "Radial"};
+                int order = tweenSettings.order;
+                if (ImGui::Combo("Order", &order, orders, 3))
+                    tweenSettings.order = (DissolveOrder)order;
+                if (tweenSettings.order == DISSOLVE_SWEEP)
+                    ImGui::Combo("Sweep Axis", &tweenSettings.axis, axes, 3);
+                int seed = (int)tweenSettings.seed;
+                if (tweenSettings.order == DISSOLVE_RANDOM && ImGui::InputInt("Seed", &seed))
+                    tweenSettings.seed = (uint32_t)seed;
+            }
+
+            if (rangeLength < 2)
+            {
+                ImGui::TextDisabled("Set Range Length to two or more keyframes");
+            }
+            else
+            {
+                std::vector<FrameHandle> keys;
+                for (int i = 0; i < rangeLength; ++i)
+                    keys.push_back(frames[currentFrame + i]);
+                int inBetweens = (rangeLength - 1) * tweenSettings.steps;
+                ImGui::Checkbox("Preview", &tweenPreview);
+                if (tweenPreview)
+                {
+                    // Only restarts when keys or settings changed, computing the shown frame first
+                    ImGui::SameLine();
+                    tweenPreviewFrame = std::clamp(tweenPreviewFrame, 0, inBetweens - 1);
+                    ImGui::SliderInt("##tweenFrame", &tweenPreviewFrame, 0, inBetweens - 1);
+                    tween.setup(keys, tweenSettings, tweenPreviewFrame);
+                    if (!tween.advance(2.0))
+                        requestRedraw();
+                    showTween = true;
+                }
+                if (ImGui::Button("Generate"))
+                {
+                    tween.setup(keys, tweenSettings, -1);
+                    tween.insertInto(frames, currentFrame);
+                    for (int pair = rangeLength - 2; pair >= 0; --pair)
+                        history.framesInserted(currentFrame + pair + 1, tweenSettings.steps);
+                    compositor.invalidateFrom(currentFrame + 1);
+                    rangeLength += inBetweens; // keys and in-betweens
+                    tween.clear();
+                    tweenPreview = showTween = false;
+                    playback.resync();
+                    markFrameDirty();
+                    requestRedraw();
+                }
+            }
+        }
+        if (ImGui::CollapsingHeader("Layers"))
+        {
+            // The matrix editor paints the selected layer, the scene shows them all combined
+            ImGui::RadioButton("Background", &activeLayer, 0);
+            const char *blendModes[] = {"OR", "AND", "XOR", "Mask"};
+            int removed = -1;
+            bool layersChanged = false;
+            for (int i = 0; i < (int)animation.layers.size(); ++i)
+            {
+                Layer &layer = animation.layers[i];
+                int length = (int)layer.frames.size();
+                ImGui::PushID(i);
+                ImGui::RadioButton(layer.name.c_str(), &activeLayer, i + 1);
+                ImGui::SameLine();
+                bool changed = ImGui::Checkbox("Visible", &layer.visible);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(70.0f);
+                int blendMode = layer.blend;
+                if (ImGui::Combo("##blend", &blendMode, blendModes, 4))
+                {
+                    layer.blend = (BlendMode)blendMode;
+                    changed = true;
+                }
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(90.0f);
+                int offset = layer.offset;
+                if (ImGui::InputInt("Offset", &offset))
+                {
+                    compositor.invalidateRange(layer.offset, length);
+                    layer.offset = offset;
+                    changed = true;
+                }
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(90.0f);
+                if (ImGui::InputInt("Frames", &length))
+                {
+                    // Shorter layers drop frames from the end, longer ones gain blank frames
+                    length = std::max(length, 1);
+                    int oldLength = (int)layer.frames.size();
+                    if (length < oldLength)
+                    {
+                        layer.frames.erase(length, oldLength - length);
+                        // Steps on the dropped frames would land on blank ones if the layer grew back
+                        history.clear();
+                    }
+                    else if (length > oldLength)
+                    {
+                        FrameHandle blank(Frame(animation.size, animation.depth));
+                        blank.intern();
+                        for (int f = oldLength; f < length; ++f)
+                            layer.frames.push_back(blank);
+                    }
+                    compositor.invalidateRange(layer.offset + std::min(length, oldLength), std::abs(length - oldLength));
+                    layersChanged = true;
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Remove"))
+                    removed = i;
+                if (changed)
+                    compositor.invalidateRange(layer.offset, length);
+                layersChanged |= changed;
+                ImGui::PopID();
+            }
+            if (removed >= 0)
+            {
+                const Layer &layer = animation.layers[removed];
+                compositor.invalidateRange(layer.offset, (int)layer.frames.size());
+                animation.layers.erase(animation.layers.begin() + removed);
+                history.clear(); // entries name layers by position
+                if (activeLayer > removed)
+                    activeLayer = activeLayer == removed + 1 ? 0 : activeLayer - 1;
+                layersChanged = true;
+            }
+            if (ImGui::Button("Add Layer"))
+            {
+                animation.addLayer("Layer " + std::to_string(animation.layers.size() + 1), (int)frames.size());
+                activeLayer = (int)animation.layers.size();
+                layersChanged = true;
+            }
+            ImGui::SameLine();
+            ImGui::Text("%zu composites cached", compositor.cachedFrames());
+            if (layersChanged)
+            {
+                markFrameDirty();
+                requestRedraw();
+            }
+        }
         ImGui::End();
         ImGui::Begin("Matrix Editor");
 
-        ImGui::SliderInt("Z Layer", &editLayer, 0, CUBE_SIZE - 1);
+        const CubeSize &size = animation.size;
+        editLayer = std::clamp(editLayer, 0, size.x - 1);
+        ImGui::SliderInt("Z Layer", &editLayer, 0, size.x - 1);
+        std::vector<uint32_t> &palette = animation.palette;
+        int maxValue = palette.empty() ? (1 << animation.depth) - 1 : (int)palette.size() - 1;
+        brushValue = std::clamp(brushValue, 1, std::max(maxValue, 1));
+        if (!palette.empty())
+        {
+            // Swatches pick the brush, the color of the selected one can be edited
+            for (int i = 1; i <= maxValue; ++i)
+            {
+                ImGui::PushID(i);
+                if (ImGui::ColorButton("##swatch", paletteColor(palette[i])))
+                    brushValue = i;
+                ImGui::PopID();
+                ImGui::SameLine();
+            }
+            if (palette.size() < MAX_PALETTE_SIZE && ImGui::Button("+"))
+            {
+                int oldDepth = animation.depth;
+                animation.addColor(0xffffff);
+                if (animation.depth != oldDepth)
+                {
+                    history.clear();
+                    compositor.invalidateAll();
+                }
+                brushValue = (int)palette.size() - 1;
+            }
+            ImGui::NewLine();
+            float rgbEdit[3];
+            ImVec4 brushColor = paletteColor(palette[brushValue]);
+            rgbEdit[0] = brushColor.x;
+            rgbEdit[1] = brushColor.y;
+            rgbEdit[2] = brushColor.z;
+            if (ImGui::ColorEdit3("Brush", rgbEdit))
+            {
+                palette[brushValue] = (uint32_t)(rgbEdit[0] * 255.0f + 0.5f) << 16 |
+                                      (uint32_t)(rgbEdit[1] * 255.0f + 0.5f) << 8 |
+                                      (uint32_t)(rgbEdit[2] * 255.0f + 0.5f);
+                requestRedraw();
+            }
+        }
+        else if (maxValue > 1)
+        {
+            ImGui::SliderInt("Brush", &brushValue, 1, maxValue);
+        }
+
+        // Edits go to the selected layer's frame under the current output frame
+        activeLayer = std::min(activeLayer, (int)animation.layers.size());
+        Timeline &editFrames = animation.layerFrames(activeLayer);
+        int editIndex = currentFrame - animation.layerOffset(activeLayer);
+        bool editable = editIndex >= 0 && editIndex < (int)editFrames.size();
+        ImGui::BeginDisabled(!editable);
         if (ImGui::Button("Clear Layer"))
         {
-            for (int x = 0; x < CUBE_SIZE; ++x)
-                for (int y = 0; y < CUBE_SIZE; ++y)
-                    frames[currentFrame].voxels[x][y][editLayer] = 0;
+            history.beginEdit(animation, editIndex, activeLayer);
+            editFrames[editIndex].edit().fillLayerX(editLayer, false);
+            editFrames[editIndex].intern();
+            history.endEdit(animation);
+            compositor.invalidate(animation, activeLayer, editIndex);
+            markFrameDirty();
+            requestRedraw();
         }
+        ImGui::EndDisabled();
 
-        // Render 8x8 grid
-        for (int x = 0; x < CUBE_SIZE; ++x)
+        // Undo/redo, also on Ctrl+Z and Ctrl+Y or Ctrl+Shift+Z
+        bool shortcuts = IO.KeyCtrl && !IO.WantTextInput;
+        bool undoKey = shortcuts && !IO.KeyShift && ImGui::IsKeyPressed(ImGuiKey_Z);
+        bool redoKey = shortcuts && (ImGui::IsKeyPressed(ImGuiKey_Y) || (IO.KeyShift && ImGui::IsKeyPressed(ImGuiKey_Z)));
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!history.canUndo());
+        undoKey |= ImGui::Button("Undo");
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!history.canRedo());
+        redoKey |= ImGui::Button("Redo");
+        ImGui::EndDisabled();
+        if (undoKey || redoKey)
         {
-            for (int y = 0; y < CUBE_SIZE; ++y)
+            strokeValue = -1;
+            int changed = undoKey ? history.undo(animation) : history.redo(animation);
+            if (changed >= 0)
             {
-                uint8_t &cell = frames[currentFrame].voxels[CUBE_SIZE - x - 1][CUBE_SIZE - 1 - y][editLayer];
-                ImGui::PushID(y * CUBE_SIZE + x);
-                ImGui::PushStyleColor(ImGuiCol_Button, cell ? ImVec4(0.2f, 0.8f, 1.0f, 1.0f) : ImVec4(0.2f, 0.2f, 0.2f, 1.0f));
-                if (ImGui::Button(" ", ImVec2(30, 30)))
+                int layer = history.changedLayer();
+                int shown = changed + animation.layerOffset(layer);
+                compositor.invalidateRange(shown, history.changedSpan());
+                if (shown >= 0 && shown < (int)frames.size())
+                    currentFrame = shown;
+                activeLayer = layer;
+                playback.resync();
+                markFrameDirty();
+            }
+            requestRedraw();
+        }
+        ImGui::SameLine();
+        ImGui::Text("%zu steps, %.1f KB", history.undoSteps(), history.bytes() / 1024.0);
+        if (ImGui::InputInt("Undo budget (KB)", &undoBudgetKB))
+        {
+            undoBudgetKB = std::max(undoBudgetKB, 1);
+            history.setBudget((size_t)undoBudgetKB * 1024);
+        }
+
+        // A press on a cell starts a stroke painting every cell dragged over
+        // with one value, recorded as a single undo step
+        if (strokeValue >= 0 && !ImGui::IsMouseDown(ImGuiMouseButton_Left))
+        {
+            history.endEdit(animation);
+            strokeValue = -1;
+        }
+
+        // Render the layer as seen from the default camera: top row is the highest z
+        if (!editable)
+            ImGui::TextDisabled("%s has no frame here", animation.layers[activeLayer - 1].name.c_str());
+        float cellSize = std::clamp(480.0f / std::max(size.y, size.z), 8.0f, 30.0f);
+        for (int row = 0; editable && row < size.z; ++row)
+        {
+            for (int col = 0; col < size.y; ++col)
+            {
+                int y = size.y - 1 - col, z = size.z - 1 - row;
+                const Frame &frame = *editFrames[editIndex]; // an edit may repoint the handle
+                int cell = frame.value(editLayer, y, z);
+                float level = (float)cell / frame.maxValue();
+                ImVec4 cellColor = ImVec4(0.2f, 0.2f + 0.6f * level, 0.2f + 0.8f * level, 1.0f);
+                if (!palette.empty())
+                    cellColor = cell ? paletteColor(cell < (int)palette.size() ? palette[cell] : 0) : ImVec4(0.2f, 0.2f, 0.2f, 1.0f);
+                ImGui::PushID(row * size.y + col);
+                ImGui::PushStyleColor(ImGuiCol_Button, cellColor);
+                ImGui::Button(" ", ImVec2(cellSize, cellSize));
+                if (ImGui::IsItemActivated())
+                {
+                    // Pressing a cell painted with the brush erases instead
+                    strokeValue = cell == brushValue ? 0 : brushValue;
+                }
+                if (strokeValue >= 0 && cell != strokeValue &&
+                    ImGui::IsMouseHoveringRect(ImGui::GetItemRectMin(), ImGui::GetItemRectMax()))
                 {
-                    cell = !cell;
+                    history.beginEdit(animation, editIndex, activeLayer); // no-op within the stroke's frame
+                    Frame &edited = editFrames[editIndex].edit();
+                    edited.setValue(editLayer, y, z, strokeValue);
+                    markVoxelDirty(edited.wordIndex(editLayer, y, z));
+                    editFrames[editIndex].intern();
+                    compositor.invalidate(animation, activeLayer, editIndex);
+                    requestRedraw();
                 }
                 ImGui::PopStyleColor();
                 ImGui::PopID();
@@ -289,58 +1101,306 @@ void mainLoop(std::vector <Frame> &frames)
 
         ImGui::End();
 
+        if (showPerfHud)
+            drawPerfHud(&showPerfHud);
+
         ImGui::Render();
+        perfAddTime(PERF_CPU_UI_BUILD, perfElapsedMs(uiStart));
+
+        auto sceneStart = std::chrono::steady_clock::now();
+        int prev_w = display_w, prev_h = display_h;
         glfwGetFramebufferSize(window, &display_w, &display_h);
+        if (display_w != prev_w || display_h != prev_h)
+            updateProjection();
         glViewport(0, 0, display_w, display_h);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        drawCube3D(frames[currentFrame].voxels, voxelShader, cubeVAO, view, projection);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        glfwSwapBuffers(window);
-        auto end = std::chrono::high_resolution_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-        if (elapsed < frame_time_ms) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(frame_time_ms - elapsed));
+        perfGpuBegin(PERF_GPU_SCENE);
+        uploadPalette(animation.palette);
+        if (showTween)
+        {
+            markFrameDirty(); // each preview frame replaces the last in full
+            drawScene(*tween.frame(tweenPreviewFrame), -2, displayMode);
+        }
+        else
+        {
+            drawScene(*compositor.frame(animation, currentFrame), currentFrame, displayMode);
         }
+        perfGpuEnd();
+        perfAddTime(PERF_CPU_SCENE, perfElapsedMs(sceneStart));
+
+        {
+            PerfScope uiRenderScope(PERF_CPU_UI_RENDER);
+            ImDrawData *drawData = ImGui::GetDrawData();
+            for (int i = 0; i < drawData->CmdListsCount; ++i)
+                perfCount(PERF_DRAW_CALLS, drawData->CmdLists[i]->CmdBuffer.Size);
+            perfGpuBegin(PERF_GPU_UI);
+            ImGui_ImplOpenGL3_RenderDrawData(drawData);
+            perfGpuEnd();
+        }
+        {
+            PerfScope swapScope(PERF_CPU_SWAP);
+            glfwSwapBuffers(window);
+        }
+        uiInteracting = ImGui::IsAnyItemActive();
+        perfAddTime(PERF_CPU_FRAME, perfElapsedMs(start));
+        perfEndFrame();
+        auto nextFrame = start + frame_period;
+        if (playback.playing())
+            nextFrame = std::min(nextFrame, playback.nextFrameTime());
+        std::this_thread::sleep_until(nextFrame);
+    }
+}
+
+// Draw one frame with the renderer of the given DisplayMode
+void drawScene(const Frame &frame, int frameIndex, int mode)
+{
+    updateCamera();
+    if (mode == DISPLAY_SOLID)
+    {
+        updateSolidMesh(frame);
+        drawSolid(solidShader);
+    }
+    else if (mode == DISPLAY_RAYMARCH)
+    {
+        uploadVoxelState(frame, frameIndex);
+        drawRaymarch(raymarchShader);
+    }
+    else
+    {
+        uploadVoxelState(frame, frameIndex);
+        drawCube3D(voxelShader, cubeVAO);
+    }
+}
+
+void markVoxelDirty(int index)
+{
+    if (dirtyBegin == dirtyEnd)
+    {
+        dirtyBegin = index;
+        dirtyEnd = index + 1;
+        return;
     }
+    dirtyBegin = std::min(dirtyBegin, index);
+    dirtyEnd = std::max(dirtyEnd, index + 1);
 }
 
-void drawCube3D(const uint8_t cube[8][8][8], GLuint shaderProgram, GLuint cubeVAO,
-                const glm::mat4 &view, const glm::mat4 &projection)
+void markFrameDirty()
 {
-    float spacing = 1.0f; // Leave gaps between voxels
+    gpuFrame = -1;
+}
 
-    glUseProgram(shaderProgram);
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+// Patch voxelBitsBuffer with the words of `frame` that differ from what the GPU
+// holds. Only the edited range is compared unless the displayed frame changed.
+void uploadVoxelState(const Frame &frame, int frameIndex)
+{
+    if (frame.size != gpuSize || frame.depth != gpuDepth)
+        resizeVoxelBuffers(frame.size, frame.depth);
 
-    glBindVertexArray(cubeVAO);
+    int begin = dirtyBegin, end = dirtyEnd;
+    if (frameIndex != gpuFrame)
+    {
+        begin = 0;
+        end = (int)gpuBits.size();
+    }
+    else if (begin < end)
+    {
+        end += (frame.depth - 1) * (int)frame.planeWords(); // edits touch every plane
+    }
+    dirtyBegin = dirtyEnd = 0;
+    gpuFrame = frameIndex;
+    if (begin >= end)
+        return;
 
-    for (int z = 0; z < 8; ++z)
+    glBindBuffer(GL_TEXTURE_BUFFER, voxelBitsBuffer);
+    int i = begin;
+    while (i < end)
     {
-        for (int y = 0; y < 8; ++y)
+        while (i < end && gpuBits[i] == frame.word(i))
+            ++i;
+        if (i == end)
+            break;
+
+        // Extend the run over short clean gaps to keep the number of uploads low
+        int runEnd = i + 1;
+        for (int j = runEnd, clean = 0; j < end && clean < uploadMergeGap; ++j)
         {
-            for (int x = 0; x < 8; ++x)
+            if (gpuBits[j] != frame.word(j))
             {
-                glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z) * spacing);
-                glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-                if (cube[z][y][x])
-                {
-                    glUniform3f(glGetUniformLocation(shaderProgram, "color"), 0.2f, 0.8f, 1.0f); // Cyan
-                }
-                else
-                {
-                    glUniform3f(glGetUniformLocation(shaderProgram, "color"), 0.1f, 0.1f, 0.1f); // Dark gray
-                }
-                glDrawArrays(GL_TRIANGLES, 0, 36);
+                runEnd = j + 1;
+                clean = 0;
+            }
+            else
+            {
+                ++clean;
             }
         }
+
+        int bytes = (runEnd - i) * (int)sizeof(uint64_t);
+        for (int j = i; j < runEnd; ++j)
+            gpuBits[j] = frame.word(j);
+        glBufferSubData(GL_TEXTURE_BUFFER, i * sizeof(uint64_t), bytes, &gpuBits[i]);
+        perfCount(PERF_UPLOAD_BYTES, bytes);
+        i = runEnd;
     }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Mirror the animation palette into paletteBuffer when it changed
+void uploadPalette(const std::vector<uint32_t> &palette)
+{
+    if (palette == gpuPalette)
+        return;
+    gpuPalette = palette;
+    if (palette.empty())
+        return; // the shaders fall back to brightness, the old texels are unused
+
+    std::vector<uint8_t> texels(palette.size() * 4);
+    for (size_t i = 0; i < palette.size(); ++i)
+    {
+        texels[i * 4 + 0] = (palette[i] >> 16) & 0xff;
+        texels[i * 4 + 1] = (palette[i] >> 8) & 0xff;
+        texels[i * 4 + 2] = palette[i] & 0xff;
+        texels[i * 4 + 3] = 255;
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, paletteBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, texels.size(), texels.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    perfCount(PERF_UPLOAD_BYTES, (int)texels.size());
+}
+
+// Set the uniforms and textures read by voxelValue() and the palette lookups
+static void bindVoxelTextures(const ShaderProgram &shader)
+{
+    glUniform1i(shader.uniform("voxelBits"), 0);
+    glUniform2i(shader.uniform("bricks"), Frame::bricks(gpuSize.x), Frame::bricks(gpuSize.y));
+    glUniform1i(shader.uniform("depth"), gpuDepth);
+    glUniform1i(shader.uniform("planeWords"), (int)Frame::wordCount(gpuSize));
+    glUniform1i(shader.uniform("palette"), 1);
+    glUniform1i(shader.uniform("usePalette"), !gpuPalette.empty());
+    perfCount(PERF_UNIFORM_UPLOADS, 6);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, voxelBitsTexture);
+}
+
+void drawCube3D(const ShaderProgram &shader, GLuint cubeVAO)
+{
+    int voxelCount = gpuSize.count();
 
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, -1.0f, -1.0f) * spacing);
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniform3f(glGetUniformLocation(shaderProgram, "color"), 1.0f, 0.0f, 0.0f); // Red
+    shader.use();
+    GLint modelLoc = shader.uniform("model");
+    GLint onColorLoc = shader.uniform("onColor");
+    GLint offColorLoc = shader.uniform("offColor");
+    bindVoxelTextures(shader);
+
+    glBindVertexArray(cubeVAO);
+
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+    glUniform3f(onColorLoc, 0.2f, 0.8f, 1.0f);  // Cyan
+    glUniform3f(offColorLoc, 0.1f, 0.1f, 0.1f); // Dark gray
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, voxelCount);
+    perfCount(PERF_UNIFORM_UPLOADS, 3);
+    perfCount(PERF_DRAW_CALLS);
+
+    // Origin marker, drawn as instance 0 shifted to (-1, -1, -1)
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, -1.0f, -1.0f));
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    glUniform3f(onColorLoc, 1.0f, 0.0f, 0.0f); // Red
+    glUniform3f(offColorLoc, 1.0f, 0.0f, 0.0f);
     glDrawArrays(GL_TRIANGLES, 0, 36);
+    perfCount(PERF_UNIFORM_UPLOADS, 3);
+    perfCount(PERF_DRAW_CALLS);
 
     glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glUseProgram(0);
+}
+
+
+// Re-mesh the chunks of `frame` that changed and re-upload only their buffers
+void updateSolidMesh(const Frame &frame)
+{
+    const std::vector<int> &rebuilt = solidMesher.update(frame);
+    if (rebuilt.empty())
+        return;
+
+    int chunkCount = solidMesher.chunkCount();
+    if ((int)solidVAOs.size() != chunkCount)
+    {
+        glDeleteVertexArrays((GLsizei)solidVAOs.size(), solidVAOs.data());
+        glDeleteBuffers((GLsizei)solidVBOs.size(), solidVBOs.data());
+        solidVAOs.assign(chunkCount, 0);
+        solidVBOs.assign(chunkCount, 0);
+        solidVertexCounts.assign(chunkCount, 0);
+        glGenVertexArrays(chunkCount, solidVAOs.data());
+        glGenBuffers(chunkCount, solidVBOs.data());
+        for (int i = 0; i < chunkCount; ++i)
+        {
+            glBindVertexArray(solidVAOs[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, solidVBOs[i]);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void *)offsetof(MeshVertex, x));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void *)offsetof(MeshVertex, nx));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void *)offsetof(MeshVertex, value));
+        }
+        glBindVertexArray(0);
+    }
+
+    for (int chunk : rebuilt)
+    {
+        const std::vector<MeshVertex> &vertices = solidMesher.chunkVertices(chunk);
+        glBindBuffer(GL_ARRAY_BUFFER, solidVBOs[chunk]);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_DYNAMIC_DRAW);
+        solidVertexCounts[chunk] = (GLsizei)vertices.size();
+        perfCount(PERF_UPLOAD_BYTES, (int)(vertices.size() * sizeof(MeshVertex)));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void drawSolid(const ShaderProgram &shader)
+{
+    shader.use();
+    glUniform3f(shader.uniform("color"), 0.2f, 0.8f, 1.0f); // Cyan
+    glUniform1f(shader.uniform("maxValue"), (float)solidMesher.maxValue());
+    perfCount(PERF_UNIFORM_UPLOADS, 2);
+    bindVoxelTextures(shader);
+    for (size_t i = 0; i < solidVAOs.size(); ++i)
+    {
+        if (!solidVertexCounts[i])
+            continue;
+        glBindVertexArray(solidVAOs[i]);
+        glDrawArrays(GL_TRIANGLES, 0, solidVertexCounts[i]);
+        perfCount(PERF_DRAW_CALLS);
+    }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glUseProgram(0);
+}
+
+// One full-screen triangle; the fragment shader walks each pixel's ray through
+// the volume, so the cost follows the pixel count instead of the LED count
+void drawRaymarch(const ShaderProgram &shader)
+{
+    glm::mat4 invViewProj = glm::inverse(projection * view);
+
+    shader.use();
+    glUniformMatrix4fv(shader.uniform("invViewProj"), 1, GL_FALSE, glm::value_ptr(invViewProj));
+    glUniform3f(shader.uniform("cameraPos"), cameraPos.x, cameraPos.y, cameraPos.z);
+    glUniform3i(shader.uniform("size"), gpuSize.x, gpuSize.y, gpuSize.z);
+    glUniform3f(shader.uniform("color"), 0.2f, 0.8f, 1.0f); // Cyan
+    bindVoxelTextures(shader);
+
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(raymarchVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+    perfCount(PERF_UNIFORM_UPLOADS, 4);
+    perfCount(PERF_DRAW_CALLS);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
     glUseProgram(0);
 }
\ No newline at end of file
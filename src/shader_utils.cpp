@@ -1,31 +1,64 @@
 // shader_utils.cpp
 #include "shader_utils.h"
 
-GLuint LoadShaderProgram(const char* vertexPath, const char* fragmentPath) {
-    std::string vCode, fCode;
-    std::ifstream vShaderFile(vertexPath), fShaderFile(fragmentPath);
+static GLuint CompileShader(GLenum type, const char* source, const char* path) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
 
-    if (!vShaderFile || !fShaderFile) {
-        std::cerr << "Error loading shader files.\n";
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        GLint logLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        std::string log(logLength > 0 ? logLength : 1, '\0');
+        glGetShaderInfoLog(shader, (GLsizei)log.size(), NULL, &log[0]);
+        std::cerr << "Error compiling " << path << ":\n" << log.c_str() << "\n";
+        glDeleteShader(shader);
         return 0;
     }
+    return shader;
+}
 
-    std::stringstream vStream, fStream;
-    vStream << vShaderFile.rdbuf();
-    fStream << fShaderFile.rdbuf();
-    vCode = vStream.str();
-    fCode = fStream.str();
-
-    const char* vSource = vCode.c_str();
-    const char* fSource = fCode.c_str();
+// GLSL has no includes of its own: a line `#include "name"` is replaced by the
+// file of that name next to `path`, and #line keeps error line numbers right.
+static bool ReadShaderSource(const std::string& path, std::string& code) {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::string dir = path.substr(0, path.find_last_of("/\\") + 1);
+    std::stringstream out;
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number) {
+        if (line.compare(0, 10, "#include \"") != 0) {
+            out << line << "\n";
+            continue;
+        }
+        std::string included, name = line.substr(10, line.find('"', 10) - 10);
+        if (!ReadShaderSource(dir + name, included)) {
+            std::cerr << "Error loading " << dir + name << ", included by " << path << "\n";
+            return false;
+        }
+        out << "#line 1\n" << included << "\n#line " << number + 1 << "\n";
+    }
+    code = out.str();
+    return true;
+}
 
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vSource, NULL);
-    glCompileShader(vertexShader);
+GLuint LoadShaderProgram(const char* vertexPath, const char* fragmentPath) {
+    std::string vCode, fCode;
+    if (!ReadShaderSource(vertexPath, vCode) || !ReadShaderSource(fragmentPath, fCode)) {
+        std::cerr << "Error loading shader files.\n";
+        return 0;
+    }
 
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fSource, NULL);
-    glCompileShader(fragmentShader);
+    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vCode.c_str(), vertexPath);
+    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fCode.c_str(), fragmentPath);
+    if (!vertexShader || !fragmentShader) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
 
     GLuint program = glCreateProgram();
     glAttachShader(program, vertexShader);
@@ -35,5 +68,61 @@ GLuint LoadShaderProgram(const char* vertexPath, const char* fragmentPath) {
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        GLint logLength = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+        std::string log(logLength > 0 ? logLength : 1, '\0');
+        glGetProgramInfoLog(program, (GLsizei)log.size(), NULL, &log[0]);
+        std::cerr << "Error linking " << vertexPath << " + " << fragmentPath << ":\n" << log.c_str() << "\n";
+        glDeleteProgram(program);
+        return 0;
+    }
+
     return program;
+}
+
+bool ShaderProgram::load(const char* vertexPath, const char* fragmentPath) {
+    destroy();
+    program = LoadShaderProgram(vertexPath, fragmentPath);
+    if (!program)
+        return false;
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+        std::string uniformName(name.data(), length);
+        GLint location = glGetUniformLocation(program, uniformName.c_str());
+        if (location < 0)
+            continue; // member of a uniform block
+        // Arrays are reported as "name[0]", callers look them up as "name"
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            uniformName.resize(uniformName.size() - 3);
+        uniforms[uniformName] = location;
+    }
+
+    GLuint cameraBlock = glGetUniformBlockIndex(program, "Camera");
+    if (cameraBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, cameraBlock, CAMERA_UBO_BINDING);
+
+    return true;
+}
+
+void ShaderProgram::destroy() {
+    if (program)
+        glDeleteProgram(program);
+    program = 0;
+    uniforms.clear();
+}
+
+GLint ShaderProgram::uniform(const std::string& name) const {
+    auto it = uniforms.find(name);
+    return it != uniforms.end() ? it->second : -1;
 }
\ No newline at end of file
@@ -7,7 +7,27 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <glad/glad.h>
 
+// Uniform buffer binding point of the shared "Camera" block (view, projection)
+constexpr GLuint CAMERA_UBO_BINDING = 0;
+
 GLuint LoadShaderProgram(const char* vertexPath, const char* fragmentPath);
+
+// Linked program with its active uniform locations resolved once at link time
+class ShaderProgram {
+public:
+    bool load(const char* vertexPath, const char* fragmentPath);
+    void destroy();
+
+    void use() const { glUseProgram(program); }
+    GLuint id() const { return program; }
+    // Location of an active uniform, -1 if the program has no such uniform
+    GLint uniform(const std::string& name) const;
+
+private:
+    GLuint program = 0;
+    std::unordered_map<std::string, GLint> uniforms;
+};
 #endif
\ No newline at end of file
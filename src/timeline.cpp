@@ -0,0 +1,190 @@
+#include "timeline.h"
+
+// Freed nodes point here so they do not keep frame contents alive
+static const FrameHandle &releasedFrame()
+{
+    static const FrameHandle frame;
+    return frame;
+}
+
+int Timeline::find(size_t index) const
+{
+    int node = root;
+    for (;;)
+    {
+        const Node &n = nodes[node];
+        size_t leftCount = n.left >= 0 ? nodes[n.left].count : 0;
+        if (index == leftCount)
+            return node;
+        if (index < leftCount)
+        {
+            node = n.left;
+        }
+        else
+        {
+            index -= leftCount + 1;
+            node = n.right;
+        }
+    }
+}
+
+int Timeline::newNode(FrameHandle frame, uint32_t priority)
+{
+    Node node{std::move(frame), -1, -1, 1, priority};
+    if (!freeNodes.empty())
+    {
+        int index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = std::move(node);
+        return index;
+    }
+    nodes.push_back(std::move(node));
+    return (int)nodes.size() - 1;
+}
+
+void Timeline::release(int node)
+{
+    if (node < 0)
+        return;
+    release(nodes[node].left);
+    release(nodes[node].right);
+    nodes[node].frame = releasedFrame();
+    freeNodes.push_back(node);
+}
+
+// Same shape and priorities, so the copy is a valid treap on its own
+int Timeline::copyTree(int node)
+{
+    if (node < 0)
+        return -1;
+    int left = copyTree(nodes[node].left);
+    int right = copyTree(nodes[node].right);
+    int copy = newNode(nodes[node].frame, nodes[node].priority);
+    nodes[copy].left = left;
+    nodes[copy].right = right;
+    return update(copy);
+}
+
+int Timeline::update(int node)
+{
+    Node &n = nodes[node];
+    n.count = 1 + (n.left >= 0 ? nodes[n.left].count : 0) + (n.right >= 0 ? nodes[n.right].count : 0);
+    return node;
+}
+
+// Cut the tree into its first `count` frames and the rest
+void Timeline::split(int node, size_t count, int &left, int &right)
+{
+    if (node < 0)
+    {
+        left = right = -1;
+        return;
+    }
+    size_t leftCount = nodes[node].left >= 0 ? nodes[nodes[node].left].count : 0;
+    if (count <= leftCount)
+    {
+        split(nodes[node].left, count, left, nodes[node].left);
+        right = update(node);
+    }
+    else
+    {
+        split(nodes[node].right, count - leftCount - 1, nodes[node].right, right);
+        left = update(node);
+    }
+}
+
+int Timeline::merge(int left, int right)
+{
+    if (left < 0)
+        return right;
+    if (right < 0)
+        return left;
+    if (nodes[left].priority > nodes[right].priority)
+    {
+        nodes[left].right = merge(nodes[left].right, right);
+        return update(left);
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    return update(right);
+}
+
+void Timeline::clear()
+{
+    nodes.clear();
+    freeNodes.clear();
+    root = -1;
+}
+
+// xorshift32, the treap only needs priorities that look random
+uint32_t Timeline::nextPriority()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+void Timeline::insert(size_t at, FrameHandle frame)
+{
+    int left, right;
+    split(root, at, left, right);
+    root = merge(merge(left, newNode(std::move(frame), nextPriority())), right);
+}
+
+void Timeline::append(std::vector<FrameHandle> frames)
+{
+    // Keep the right spine of the new tree on a stack. Each node takes the
+    // spine nodes of lower priority as its left subtree; their subtrees are
+    // complete once they leave the spine, so that is when they are counted.
+    std::vector<int> spine;
+    nodes.reserve(nodes.size() + frames.size());
+    for (auto &frame : frames)
+    {
+        int node = newNode(std::move(frame), nextPriority());
+        int below = -1;
+        while (!spine.empty() && nodes[spine.back()].priority < nodes[node].priority)
+        {
+            below = update(spine.back());
+            spine.pop_back();
+        }
+        nodes[node].left = below;
+        if (!spine.empty())
+            nodes[spine.back()].right = node;
+        spine.push_back(node);
+    }
+    int built = -1;
+    while (!spine.empty())
+    {
+        built = update(spine.back());
+        spine.pop_back();
+    }
+    root = merge(root, built);
+}
+
+void Timeline::erase(size_t at, size_t count)
+{
+    int left, middle, right;
+    split(root, at, left, right);
+    split(right, count, middle, right);
+    release(middle);
+    root = merge(left, right);
+}
+
+void Timeline::move(size_t at, size_t count, size_t to)
+{
+    int left, middle, right;
+    split(root, at, left, right);
+    split(right, count, middle, right);
+    int rest = merge(left, right);
+    split(rest, to, left, right);
+    root = merge(merge(left, middle), right);
+}
+
+void Timeline::duplicate(size_t at, size_t count)
+{
+    int left, middle, right;
+    split(root, at + count, left, right);
+    split(left, at, left, middle);
+    int copy = copyTree(middle);
+    root = merge(merge(merge(left, middle), copy), right);
+}
\ No newline at end of file
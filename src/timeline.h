@@ -0,0 +1,97 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_TIMELINE_H_
+#define _LEDCUBEEDITOR_TIMELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "frame.h"
+
+// Sequence of frame handles kept as an implicit treap: a randomized binary
+// tree ordered by position, where each node stores the size of its subtree.
+// Indexing, inserting, erasing and moving ranges split and merge the tree in
+// O(log n) instead of shifting every frame after the edit point. Nodes live
+// in one vector with a free list, so copying a timeline is a flat copy.
+class Timeline
+{
+    struct Node
+    {
+        FrameHandle frame;
+        int left, right;
+        uint32_t count;
+        uint32_t priority;
+    };
+
+public:
+    template <bool Const>
+    class Iterator
+    {
+    public:
+        using Owner = std::conditional_t<Const, const Timeline, Timeline>;
+        using Reference = std::conditional_t<Const, const FrameHandle &, FrameHandle &>;
+
+        Iterator(Owner *timeline, int root) : timeline(timeline) { descend(root); }
+        Reference operator*() const { return timeline->nodes[path.back()].frame; }
+        Iterator &operator++()
+        {
+            int node = path.back();
+            path.pop_back();
+            descend(timeline->nodes[node].right);
+            return *this;
+        }
+        bool operator!=(const Iterator &other) const
+        {
+            return path.empty() != other.path.empty() || (!path.empty() && path.back() != other.path.back());
+        }
+
+    private:
+        void descend(int node)
+        {
+            for (; node >= 0; node = timeline->nodes[node].left)
+                path.push_back(node);
+        }
+
+        Owner *timeline;
+        std::vector<int> path; // ancestors still to visit, the current node last
+    };
+
+    size_t size() const { return root < 0 ? 0 : nodes[root].count; }
+    bool empty() const { return root < 0; }
+    FrameHandle &operator[](size_t index) { return nodes[find(index)].frame; }
+    const FrameHandle &operator[](size_t index) const { return nodes[find(index)].frame; }
+    FrameHandle &back() { return (*this)[size() - 1]; }
+
+    Iterator<false> begin() { return Iterator<false>(this, root); }
+    Iterator<false> end() { return Iterator<false>(this, -1); }
+    Iterator<true> begin() const { return Iterator<true>(this, root); }
+    Iterator<true> end() const { return Iterator<true>(this, -1); }
+
+    void clear();
+    void push_back(FrameHandle frame) { insert(size(), std::move(frame)); }
+    void insert(size_t at, FrameHandle frame);
+    // Add frames at the end, building their part of the tree in one pass
+    void append(std::vector<FrameHandle> frames);
+    void erase(size_t at, size_t count = 1);
+    // Move [at, at + count) so it starts at index `to` of the result
+    void move(size_t at, size_t count, size_t to);
+    // Insert a copy of [at, at + count) right after it. Copies share contents.
+    void duplicate(size_t at, size_t count);
+
+private:
+    int find(size_t index) const;
+    uint32_t nextPriority();
+    int newNode(FrameHandle frame, uint32_t priority);
+    void release(int node);
+    int copyTree(int node);
+    int update(int node);
+    void split(int node, size_t count, int &left, int &right);
+    int merge(int left, int right);
+
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    int root = -1;
+    uint32_t seed = 0x9e3779b9u;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <unordered_map>
+#include "bit_matrix.h"
+#include "parallel.h"
+#include "transform.h"
+
+static inline void swapBlocks(uint64_t &a, uint64_t &b, int shift, uint64_t mask)
+{
+    uint64_t t = ((a >> shift) ^ b) & mask;
+    a ^= t << shift;
+    b ^= t;
+}
+
+// Swap y and z inside a brick: byte y of word z goes to byte z of word y
+static void transposeBrickRows(uint64_t *w)
+{
+    for (int i = 0; i < 4; ++i)
+        swapBlocks(w[i], w[i + 4], 32, 0x00000000ffffffffull);
+    for (int i : {0, 1, 4, 5})
+        swapBlocks(w[i], w[i + 2], 16, 0x0000ffff0000ffffull);
+    for (int i = 0; i < 8; i += 2)
+        swapBlocks(w[i], w[i + 1], 8, 0x00ff00ff00ff00ffull);
+}
+
+struct BrickGrid
+{
+    int x, y, z;
+    explicit BrickGrid(CubeSize size) : x(Frame::bricks(size.x)), y(Frame::bricks(size.y)), z(Frame::bricks(size.z)) {}
+    size_t brick(int bx, int by, int bz) const { return (size_t)(bz * y + by) * x + bx; }
+};
+
+// Give every brick of `src` the place in `dst` that place(bx, by, bz, out)
+// picks. Stored bricks keep their words, only the brick map changes.
+template <typename Place>
+static void moveBricks(const Frame &src, Frame &dst, Place place)
+{
+    BrickGrid from(src.size), to(dst.size);
+    dst.store = src.store;
+    for (size_t b = src.nextBrick(0); b < src.brickCount(); b = src.nextBrick(b + 1))
+    {
+        int target[3];
+        place((int)(b % from.x), (int)(b / from.x % from.y), (int)(b / from.x / from.y), target);
+        dst.setSlot(to.brick(target[0], target[1], target[2]), src.slot(b));
+    }
+}
+
+// Per byte lane: bits below r, and bits from r up
+static inline uint64_t laneLow(int r)
+{
+    return 0x0101010101010101ull * ((1u << r) - 1);
+}
+
+static inline uint64_t laneHigh(int r)
+{
+    return 0x0101010101010101ull * ((0xffu << r) & 0xff);
+}
+
+// Zero the bits of the partial bricks past the real size
+static void clearPadding(Frame &frame)
+{
+    const CubeSize &size = frame.size;
+    BrickGrid grid(size);
+    int rx = size.x & 7, ry = size.y & 7, rz = size.z & 7;
+    uint64_t rowMask = ry ? (1ull << (ry * 8)) - 1 : ~0ull;
+    for (int bz = 0; bz < grid.z; ++bz)
+        for (int by = 0; by < grid.y; ++by)
+            for (int bx = 0; bx < grid.x; ++bx)
+            {
+                size_t b = grid.brick(bx, by, bz);
+                bool border = (rx && bx == grid.x - 1) || by == grid.y - 1 || (rz && bz == grid.z - 1);
+                if (!border || !frame.brickData(b))
+                    continue;
+                uint64_t mask = ~0ull;
+                if (rx && bx == grid.x - 1)
+                    mask &= laneLow(rx);
+                if (by == grid.y - 1)
+                    mask &= rowMask;
+                int slices = rz && bz == grid.z - 1 ? rz : 8;
+                uint64_t *brick = frame.editBrick(b);
+                for (int plane = 0; plane < frame.depth; ++plane)
+                    for (int lz = 0; lz < 8; ++lz)
+                        brick[plane * 8 + lz] = lz < slices ? brick[plane * 8 + lz] & mask : 0;
+            }
+}
+
+static int floorDiv8(int k)
+{
+    return k >= 0 ? k / 8 : -((-k + 7) / 8);
+}
+
+// Move every LED `k` steps along `axis`, dropping what leaves the cube. Only
+// words that end up lit are written, so dark bricks stay unstored.
+static Frame shiftFrame(const Frame &frame, int axis, int k)
+{
+    Frame out(frame.size, frame.depth);
+    BrickGrid grid(frame.size);
+    int q = floorDiv8(k), r = k - q * 8;
+    auto source = [&](size_t brick, int plane, int lz) -> uint64_t
+    {
+        const uint64_t *words = frame.brickData(brick);
+        return words ? words[plane * 8 + lz] : 0;
+    };
+    auto write = [&](size_t brick, int plane, int lz, uint64_t word)
+    {
+        if (word)
+            out.editBrick(brick)[plane * 8 + lz] = word;
+    };
+    for (int plane = 0; plane < frame.depth; ++plane)
+    {
+        if (axis == 2)
+        {
+            // Whole words: slice z moves to z + k. Sources may lie in the
+            // padding, which is where a mirror leaves them.
+            for (int by = 0; by < grid.y; ++by)
+                for (int bx = 0; bx < grid.x; ++bx)
+                    for (int z = std::max(0, k); z < std::min(frame.size.z, grid.z * 8 + k); ++z)
+                        write(grid.brick(bx, by, z >> 3), plane, z & 7, source(grid.brick(bx, by, (z - k) >> 3), plane, (z - k) & 7));
+            continue;
+        }
+        int lines = axis == 0 ? grid.x : grid.y;
+        for (int bz = 0; bz < grid.z; ++bz)
+            for (int other = 0; other < (axis == 0 ? grid.y : grid.x); ++other)
+                for (int lz = 0; lz < 8; ++lz)
+                {
+                    auto at = [&](int b) { return axis == 0 ? grid.brick(b, other, bz) : grid.brick(other, b, bz); };
+                    auto wordAt = [&](int b) -> uint64_t { return b >= 0 && b < lines ? source(at(b), plane, lz) : 0; };
+                    for (int b = 0; b < lines; ++b)
+                    {
+                        uint64_t hi = wordAt(b - q), lo = wordAt(b - q - 1);
+                        if (axis == 0) // columns: shift inside byte lanes
+                            write(at(b), plane, lz, ((hi << r) & laneHigh(r)) | (r ? (lo >> (8 - r)) & laneLow(r) : 0));
+                        else // rows: whole bytes
+                            write(at(b), plane, lz, (hi << (8 * r)) | (r ? lo >> (64 - 8 * r) : 0));
+                    }
+                }
+    }
+    clearPadding(out);
+    return out;
+}
+
+static Frame transposeXY(const Frame &frame)
+{
+    Frame out(CubeSize{frame.size.y, frame.size.x, frame.size.z}, frame.depth);
+    moveBricks(frame, out, [](int bx, int by, int bz, int *t) { t[0] = by, t[1] = bx, t[2] = bz; });
+    applyWordOp(WORD_TRANSPOSE, out.store.data(), out.store.size());
+    return out;
+}
+
+static Frame transposeYZ(const Frame &frame)
+{
+    Frame out(CubeSize{frame.size.x, frame.size.z, frame.size.y}, frame.depth);
+    moveBricks(frame, out, [](int bx, int by, int bz, int *t) { t[0] = bx, t[1] = bz, t[2] = by; });
+    for (size_t i = 0; i < out.store.size(); i += 8) // each plane of each brick
+        transposeBrickRows(&out.store[i]);
+    return out;
+}
+
+// (x, y, z) -> (z, y, x) is the y/z swap conjugated by the x/y swap
+static Frame transposeXZ(const Frame &frame)
+{
+    return transposeYZ(transposeXY(transposeYZ(frame)));
+}
+
+static Frame mirrorFrame(const Frame &frame, int axis)
+{
+    Frame out(frame.size, frame.depth);
+    BrickGrid grid(frame.size);
+    moveBricks(frame, out, [&](int bx, int by, int bz, int *t)
+               {
+                   t[0] = axis == 0 ? grid.x - 1 - bx : bx;
+                   t[1] = axis == 1 ? grid.y - 1 - by : by;
+                   t[2] = axis == 2 ? grid.z - 1 - bz : bz;
+               });
+    if (axis == 0)
+        applyWordOp(WORD_MIRROR_X, out.store.data(), out.store.size());
+    else if (axis == 1)
+        applyWordOp(WORD_MIRROR_Y, out.store.data(), out.store.size());
+    else
+        for (size_t i = 0; i < out.store.size(); i += 8)
+            std::reverse(&out.store[i], &out.store[i] + 8);
+
+    // The mirror was taken over whole bricks; move the LEDs back from the padding
+    int extent = axis == 0 ? frame.size.x : axis == 1 ? frame.size.y : frame.size.z;
+    int padding = Frame::bricks(extent) * 8 - extent;
+    return padding ? shiftFrame(out, axis, -padding) : out;
+}
+
+static Frame rotateFrame(const Frame &frame, int axis)
+{
+    // Quarter turn, counterclockwise looking down the axis
+    if (axis == 0)
+        return mirrorFrame(transposeYZ(frame), 1);
+    if (axis == 1)
+        return mirrorFrame(transposeXZ(frame), 2);
+    return mirrorFrame(transposeXY(frame), 0);
+}
+
+CubeSize transformedSize(CubeSize size, const Transform &transform)
+{
+    if (transform.kind != TRANSFORM_ROTATE || (transform.amount & 1) == 0)
+        return size;
+    if (transform.axis == 0)
+        return CubeSize{size.x, size.z, size.y};
+    if (transform.axis == 1)
+        return CubeSize{size.z, size.y, size.x};
+    return CubeSize{size.y, size.x, size.z};
+}
+
+Frame transformFrame(const Frame &frame, const Transform &transform)
+{
+    if (transform.kind == TRANSFORM_MIRROR)
+        return mirrorFrame(frame, transform.axis);
+    if (transform.kind == TRANSFORM_ROTATE)
+    {
+        Frame out = frame;
+        for (int turns = ((transform.amount % 4) + 4) % 4; turns > 0; --turns)
+            out = rotateFrame(out, transform.axis);
+        return out;
+    }
+
+    int extent = transform.axis == 0 ? frame.size.x : transform.axis == 1 ? frame.size.y : frame.size.z;
+    if (!transform.wrap)
+        return shiftFrame(frame, transform.axis, transform.amount);
+    // Wrapping is the shift by k mod n OR-ed with the same shift back by n
+    int k = ((transform.amount % extent) + extent) % extent;
+    Frame out = shiftFrame(frame, transform.axis, k);
+    if (k)
+    {
+        Frame back = shiftFrame(frame, transform.axis, k - extent);
+        for (size_t b = back.nextBrick(0); b < back.brickCount(); b = back.nextBrick(b + 1))
+        {
+            const uint64_t *words = back.brickData(b);
+            uint64_t *into = out.editBrick(b);
+            for (size_t i = 0; i < back.brickWords(); ++i)
+                into[i] |= words[i];
+        }
+    }
+    return out;
+}
+
+static void transformTimeline(Timeline &frames, int first, int count, const Transform &transform)
+{
+    bool scroll = transform.kind == TRANSFORM_SHIFT && transform.scroll;
+
+    // Distinct contents only, unless every frame of a scroll moves differently
+    std::vector<FrameHandle> results;
+    std::vector<size_t> slot(count);
+    std::unordered_map<FrameId, size_t, FrameIdHash> seen;
+    for (int i = 0; i < count; ++i)
+    {
+        const FrameHandle &handle = frames[first + i];
+        auto found = scroll ? seen.end() : seen.find(handle.id());
+        if (found != seen.end())
+        {
+            slot[i] = found->second;
+            continue;
+        }
+        slot[i] = results.size();
+        seen.emplace(handle.id(), results.size());
+        results.push_back(handle);
+    }
+
+    parallelFor(results.size(), [&](size_t i)
+                {
+                    Transform step = transform;
+                    if (scroll)
+                        step.amount = transform.amount * (int)(i + 1);
+                    results[i] = FrameHandle(transformFrame(*results[i], step));
+                    results[i].intern();
+                });
+
+    for (int i = 0; i < count; ++i)
+        frames[first + i] = results[slot[i]];
+}
+
+void transformFrames(Animation &animation, int first, int count, const Transform &transform)
+{
+    CubeSize newSize = transformedSize(animation.size, transform);
+    if (newSize == animation.size)
+    {
+        transformTimeline(animation.frames, first, count, transform);
+        return;
+    }
+    // Every frame of every layer has to keep the same size
+    for (int layer = 0; layer <= (int)animation.layers.size(); ++layer)
+    {
+        Timeline &frames = animation.layerFrames(layer);
+        transformTimeline(frames, 0, (int)frames.size(), transform);
+    }
+    animation.size = newSize;
+}
\ No newline at end of file
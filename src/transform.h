@@ -0,0 +1,34 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_TRANSFORM_H_
+#define _LEDCUBEEDITOR_TRANSFORM_H_
+
+#include "animation.h"
+
+enum TransformKind
+{
+    TRANSFORM_ROTATE,
+    TRANSFORM_MIRROR,
+    TRANSFORM_SHIFT,
+};
+
+struct Transform
+{
+    TransformKind kind = TRANSFORM_ROTATE;
+    int axis = 2;   // 0 = x, 1 = y, 2 = z
+    int amount = 1; // quarter turns for rotations, LEDs for shifts
+    bool wrap = false;
+    bool scroll = false; // shifts only: frame i of a range moves by amount * (i + 1)
+};
+
+// Whole-cube transforms on packed frames. Bricks are rearranged through the
+// brick map and the bits inside a brick are moved with delta swaps, using SSE2 or AVX2
+// on x86 when available.
+CubeSize transformedSize(CubeSize size, const Transform &transform);
+Frame transformFrame(const Frame &frame, const Transform &transform);
+
+// Transform frames [first, first + count) on all cores, once per distinct
+// frame. A rotation that swaps two different dimensions changes the cube size
+// and is applied to the whole animation, layers included.
+void transformFrames(Animation &animation, int first, int count, const Transform &transform);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "parallel.h"
+#include "tween.h"
+
+static const float FAR = 1e20f;
+
+// Felzenszwalb-Huttenlocher: squared distance transform of one line, given the
+// squared distance f[] already found along the earlier axes
+static void distanceLine(const float *f, int n, float *d, int *v, float *z)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -FAR;
+    z[1] = FAR;
+    for (int q = 1; q < n; ++q)
+    {
+        float s;
+        for (;;)
+        {
+            int p = v[k];
+            s = ((f[q] + q * q) - (f[p] + p * p)) / (2.0f * (q - p));
+            if (s > z[k] || k == 0)
+                break;
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = FAR;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q)
+    {
+        while (z[k + 1] < q)
+            ++k;
+        d[q] = (float)(q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+// Squared distances to the nearest voxel holding 0, one axis at a time
+static void squaredDistances(std::vector<float> &grid, CubeSize size)
+{
+    int longest = std::max({size.x, size.y, size.z});
+    std::vector<float> line(longest), out(longest), z(longest + 1);
+    std::vector<int> v(longest);
+    const int extents[3] = {size.x, size.y, size.z};
+    const size_t strides[3] = {1, (size_t)size.x, (size_t)size.x * size.y};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int n = extents[axis];
+        size_t stride = strides[axis];
+        for (size_t start = 0; start < grid.size(); ++start)
+        {
+            if ((start / stride) % n != 0)
+                continue; // not the first voxel of a line along this axis
+            for (int i = 0; i < n; ++i)
+                line[i] = grid[start + i * stride];
+            distanceLine(line.data(), n, out.data(), v.data(), z.data());
+            for (int i = 0; i < n; ++i)
+                grid[start + i * stride] = out[i];
+        }
+    }
+}
+
+std::vector<float> distanceField(const Frame &frame)
+{
+    const CubeSize &size = frame.size;
+    size_t count = (size_t)size.x * size.y * size.z;
+    std::vector<float> toLit(count), toDark(count);
+    std::vector<char> lit(count);
+    size_t i = 0;
+    for (int z = 0; z < size.z; ++z)
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x, ++i)
+            {
+                lit[i] = frame.get(x, y, z);
+                toLit[i] = lit[i] ? 0.0f : FAR;
+                toDark[i] = lit[i] ? FAR : 0.0f;
+            }
+    squaredDistances(toLit, size);
+    squaredDistances(toDark, size);
+
+    // An empty or full key gets the cube diagonal, so shapes grow from or
+    // shrink into nothing instead of popping
+    float limit = std::sqrt((float)(size.x * size.x + size.y * size.y + size.z * size.z));
+    std::vector<float> field(count);
+    for (i = 0; i < count; ++i)
+    {
+        float d = lit[i] ? 0.5f - std::sqrt(toDark[i]) : std::sqrt(toLit[i]) - 0.5f;
+        field[i] = std::clamp(d, -limit, limit);
+    }
+    return field;
+}
+
+static bool centroid(const Frame &frame, float c[3])
+{
+    double sum[3] = {0, 0, 0};
+    size_t n = 0;
+    for (int z = 0; z < frame.size.z; ++z)
+        for (int y = 0; y < frame.size.y; ++y)
+            for (int x = 0; x < frame.size.x; ++x)
+                if (frame.get(x, y, z))
+                {
+                    sum[0] += x;
+                    sum[1] += y;
+                    sum[2] += z;
+                    ++n;
+                }
+    for (int i = 0; i < 3; ++i)
+        c[i] = n ? (float)(sum[i] / n) : 0.0f;
+    return n != 0;
+}
+
+// The lit LEDs of `a`, slid from their centroid towards the one of `b` and
+// turned by t * angle, sampled backwards so nothing tears open
+static Frame motionFrame(const Frame &a, const Frame &b, float t, const TweenSettings &settings)
+{
+    Frame out(a.size, a.depth);
+    float ca[3], cb[3];
+    if (!centroid(a, ca))
+        return out;
+    if (!centroid(b, cb))
+        std::copy(ca, ca + 3, cb);
+    float c[3];
+    for (int i = 0; i < 3; ++i)
+        c[i] = ca[i] + t * (cb[i] - ca[i]);
+    float theta = -t * settings.angle * 3.14159265f / 180.0f;
+    float cs = std::cos(theta), sn = std::sin(theta);
+    int u = (settings.axis + 1) % 3, v = (settings.axis + 2) % 3; // the turning plane
+    const int extent[3] = {a.size.x, a.size.y, a.size.z};
+    for (int z = 0; z < a.size.z; ++z)
+        for (int y = 0; y < a.size.y; ++y)
+            for (int x = 0; x < a.size.x; ++x)
+            {
+                float d[3] = {x - c[0], y - c[1], z - c[2]};
+                float du = d[u] * cs - d[v] * sn, dv = d[u] * sn + d[v] * cs;
+                d[u] = du;
+                d[v] = dv;
+                int q[3];
+                bool inside = true;
+                for (int i = 0; i < 3; ++i)
+                {
+                    q[i] = (int)std::lround(ca[i] + d[i]);
+                    inside &= q[i] >= 0 && q[i] < extent[i];
+                }
+                if (inside)
+                    out.setValue(x, y, z, a.value(q[0], q[1], q[2]));
+            }
+    return out;
+}
+
+static int brightest(const Frame &frame)
+{
+    int best = 0;
+    for (int z = 0; z < frame.size.z; ++z)
+        for (int y = 0; y < frame.size.y; ++y)
+            for (int x = 0; x < frame.size.x; ++x)
+                best = std::max(best, frame.value(x, y, z));
+    return best;
+}
+
+static Frame morphFrame(const Frame &a, const Frame &b, float t, const std::vector<float> &fa, const std::vector<float> &fb)
+{
+    // Both fields travel with the centroid so keys that don't overlap still
+    // meet halfway. LEDs lit in the blend take their value from the nearer key
+    // where it is lit there, from the other key otherwise.
+    Frame out(a.size, a.depth);
+    float ca[3], cb[3];
+    bool litA = centroid(a, ca), litB = centroid(b, cb);
+    if (!litA)
+        std::copy(cb, cb + 3, ca);
+    if (!litB)
+        std::copy(ca, ca + 3, cb);
+    const int extent[3] = {a.size.x, a.size.y, a.size.z};
+    float limit = std::sqrt((float)(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]));
+    auto sample = [&](const std::vector<float> &field, const int p[3], float shift, const float from[3], const float to[3], int q[3])
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            q[i] = (int)std::lround(p[i] - shift * (to[i] - from[i]));
+            if (q[i] < 0 || q[i] >= extent[i])
+                return limit;
+        }
+        return field[q[0] + (size_t)extent[0] * (q[1] + (size_t)extent[1] * q[2])];
+    };
+
+    const Frame &nearKey = t < 0.5f ? a : b, &farKey = t < 0.5f ? b : a;
+    int fallback = std::max(brightest(nearKey), 1);
+    for (int z = 0; z < a.size.z; ++z)
+        for (int y = 0; y < a.size.y; ++y)
+            for (int x = 0; x < a.size.x; ++x)
+            {
+                const int p[3] = {x, y, z};
+                int qa[3], qb[3];
+                float da = sample(fa, p, t, ca, cb, qa), db = sample(fb, p, t - 1.0f, ca, cb, qb);
+                if ((1.0f - t) * da + t * db >= 0.0f)
+                    continue;
+                const int *nearAt = t < 0.5f ? qa : qb, *farAt = t < 0.5f ? qb : qa;
+                auto valueAt = [&](const Frame &key, const int *q)
+                {
+                    bool inside = q[0] >= 0 && q[0] < extent[0] && q[1] >= 0 && q[1] < extent[1] && q[2] >= 0 && q[2] < extent[2];
+                    return inside ? key.value(q[0], q[1], q[2]) : 0;
+                };
+                int value = valueAt(nearKey, nearAt);
+                if (!value)
+                    value = valueAt(farKey, farAt);
+                out.setValue(x, y, z, value ? value : fallback);
+            }
+    return out;
+}
+
+static float dissolveThreshold(int x, int y, int z, const CubeSize &size, const TweenSettings &settings)
+{
+    if (settings.order == DISSOLVE_SWEEP)
+    {
+        const int coord[3] = {x, y, z}, extent[3] = {size.x, size.y, size.z};
+        return (coord[settings.axis] + 0.5f) / extent[settings.axis];
+    }
+    if (settings.order == DISSOLVE_RADIAL)
+    {
+        float cx = (size.x - 1) * 0.5f, cy = (size.y - 1) * 0.5f, cz = (size.z - 1) * 0.5f;
+        float r = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy) + (z - cz) * (z - cz));
+        return r / (std::sqrt(cx * cx + cy * cy + cz * cz) + 1.0f);
+    }
+    uint32_t h = x * 73856093u ^ y * 19349663u ^ z * 83492791u ^ settings.seed * 2654435761u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h / 4294967296.0f;
+}
+
+// LEDs whose threshold has passed show `b`, the rest `a`, picked word by word
+static Frame dissolveFrame(const Frame &a, const Frame &b, float t, const TweenSettings &settings)
+{
+    Frame mask(a.size);
+    for (int z = 0; z < a.size.z; ++z)
+        for (int y = 0; y < a.size.y; ++y)
+            for (int x = 0; x < a.size.x; ++x)
+                if (dissolveThreshold(x, y, z, a.size, settings) < t)
+                    mask.setPlaneBit(0, x, y, z, true);
+    Frame out(a.size, a.depth);
+    size_t total = out.brickCount();
+    for (size_t brick = std::min(a.nextBrick(0), b.nextBrick(0)); brick < total;
+         brick = std::min(a.nextBrick(brick + 1), b.nextBrick(brick + 1)))
+    {
+        const uint64_t *from = a.brickData(brick), *to = b.brickData(brick), *m = mask.brickData(brick);
+        if (!from && !m)
+            continue;
+        uint64_t *words = out.editBrick(brick);
+        for (int plane = 0; plane < out.depth; ++plane)
+            for (int lz = 0; lz < 8; ++lz)
+            {
+                uint64_t pick = m ? m[lz] : 0;
+                uint64_t before = from ? from[plane * 8 + lz] : 0, after = to ? to[plane * 8 + lz] : 0;
+                words[plane * 8 + lz] = (before & ~pick) | (after & pick);
+            }
+    }
+    return out;
+}
+
+Frame tweenFrame(const Frame &a, const Frame &b, float t, const TweenSettings &settings,
+                 const std::vector<float> *fieldA, const std::vector<float> *fieldB)
+{
+    if (settings.mode == TWEEN_MOTION)
+        return motionFrame(a, b, t, settings);
+    if (settings.mode == TWEEN_DISSOLVE)
+        return dissolveFrame(a, b, t, settings);
+    if (fieldA && fieldB)
+        return morphFrame(a, b, t, *fieldA, *fieldB);
+    return morphFrame(a, b, t, distanceField(a), distanceField(b));
+}
+
+void Tween::setup(const std::vector<FrameHandle> &newKeys, const TweenSettings &newSettings, int first)
+{
+    bool same = newSettings == settings && newKeys.size() == keys.size();
+    for (size_t i = 0; same && i < keys.size(); ++i)
+        same = newKeys[i].id() == keys[i].id();
+    if (!same)
+    {
+        clear();
+        keys = newKeys;
+        settings = newSettings;
+        if (keys.size() >= 2 && settings.steps > 0)
+        {
+            results.assign((keys.size() - 1) * settings.steps, keys[0]); // placeholders
+            done.assign(results.size(), 0);
+            fields.resize(keys.size());
+        }
+    }
+    if (first >= 0 && first < count())
+        frame(first);
+}
+
+bool Tween::advance(double budgetMs)
+{
+    auto start = std::chrono::steady_clock::now();
+    while (nextPending < results.size())
+    {
+        if (!done[nextPending])
+            compute((int)nextPending);
+        ++nextPending;
+        if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() > budgetMs)
+            break;
+    }
+    return nextPending >= results.size();
+}
+
+void Tween::finish()
+{
+    if (settings.mode == TWEEN_MORPH)
+        parallelFor(keys.size(), [&](size_t key) { field((int)key); }, 1);
+    std::vector<int> pending;
+    for (size_t i = 0; i < results.size(); ++i)
+        if (!done[i])
+            pending.push_back((int)i);
+    parallelFor(pending.size(), [&](size_t i) { compute(pending[i]); }, 1);
+    nextPending = results.size();
+}
+
+const FrameHandle &Tween::frame(int index)
+{
+    if (!done[index])
+        compute(index);
+    return results[index];
+}
+
+void Tween::insertInto(Timeline &frames, int at)
+{
+    finish();
+    // Last pair first, so the positions of the earlier keys hold
+    int steps = settings.steps;
+    for (int pair = (int)keys.size() - 2; pair >= 0; --pair)
+        for (int step = steps - 1; step >= 0; --step)
+            frames.insert(at + pair + 1, results[pair * steps + step]);
+}
+
+void Tween::clear()
+{
+    keys.clear();
+    results.clear();
+    done.clear();
+    fields.clear();
+    nextPending = 0;
+}
+
+void Tween::compute(int index)
+{
+    int pair = index / settings.steps;
+    float t = (float)(index % settings.steps + 1) / (settings.steps + 1);
+    const Frame &a = *keys[pair], &b = *keys[pair + 1];
+    if (settings.mode == TWEEN_MORPH)
+        results[index] = FrameHandle(tweenFrame(a, b, t, settings, &field(pair), &field(pair + 1)));
+    else
+        results[index] = FrameHandle(tweenFrame(a, b, t, settings));
+    results[index].intern();
+    done[index] = 1;
+}
+
+const std::vector<float> &Tween::field(int key)
+{
+    if (fields[key].empty())
+        fields[key] = distanceField(*keys[key]);
+    return fields[key];
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef _LEDCUBEEDITOR_TWEEN_H_
+#define _LEDCUBEEDITOR_TWEEN_H_
+
+#include <cstdint>
+#include <vector>
+#include "animation.h"
+
+enum TweenMode
+{
+    TWEEN_MOTION,   // move the lit LEDs of a key towards the next one, optionally turning
+    TWEEN_MORPH,    // blend the distance fields of the two keys
+    TWEEN_DISSOLVE, // flip the LEDs that differ one by one
+};
+
+enum DissolveOrder
+{
+    DISSOLVE_RANDOM,
+    DISSOLVE_SWEEP,  // along the axis
+    DISSOLVE_RADIAL, // from the center out
+};
+
+struct TweenSettings
+{
+    TweenMode mode = TWEEN_MORPH;
+    int steps = 4;      // in-betweens per pair of keyframes
+    int axis = 2;       // turning axis for motion, sweep axis for dissolves
+    float angle = 0.0f; // motion: degrees turned from one key to the next
+    DissolveOrder order = DISSOLVE_RANDOM;
+    uint32_t seed = 1;
+
+    bool operator==(const TweenSettings &other) const
+    {
+        return mode == other.mode && steps == other.steps && axis == other.axis && angle == other.angle &&
+               order == other.order && seed == other.seed;
+    }
+    bool operator!=(const TweenSettings &other) const { return !(*this == other); }
+};
+
+// In-betweens for a run of keyframes, settings.steps of them after every key
+// but the last. They are computed on demand: the one being looked at first,
+// the rest a slice at a time for previews, or all at once on every core.
+class Tween
+{
+public:
+    // Start over unless the keys and settings are the ones already in use.
+    // In-between `first` is computed right away.
+    void setup(const std::vector<FrameHandle> &keys, const TweenSettings &settings, int first);
+    int count() const { return (int)results.size(); }
+    // Compute pending in-betweens for about `budgetMs`, true once all are done
+    bool advance(double budgetMs);
+    // Compute everything left on all cores
+    void finish();
+    // In-between `index`, computing it first if needed
+    const FrameHandle &frame(int index);
+
+    // Put every in-between after its key; the keys are frames [at, at + keys)
+    void insertInto(Timeline &frames, int at);
+    void clear();
+
+private:
+    void compute(int index);
+    const std::vector<float> &field(int key);
+
+    std::vector<FrameHandle> keys;
+    TweenSettings settings;
+    std::vector<FrameHandle> results;
+    std::vector<char> done;
+    std::vector<std::vector<float>> fields; // signed distance fields of the keys, for morphs
+    size_t nextPending = 0;
+};
+
+// In-between of keys `a` and `b` at time t in (0, 1). Morphs take the signed
+// distance fields of the keys.
+Frame tweenFrame(const Frame &a, const Frame &b, float t, const TweenSettings &settings,
+                 const std::vector<float> *fieldA = nullptr, const std::vector<float> *fieldB = nullptr);
+// Signed distance to the lit LEDs' surface, negative inside, indexed x + y * size.x + z * size.x * size.y
+std::vector<float> distanceField(const Frame &frame);
+
+#endif
\ No newline at end of file
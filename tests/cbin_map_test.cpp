@@ -0,0 +1,128 @@
+// Checks for animations imported through a .cbin mapping. Build with
+// -DLEDCUBEEDITOR_TESTS=ON and run `ctest`.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include "cbin_stream.h"
+#include "main.h"
+#include "transform.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Frames with a few random LEDs lit, no two alike
+static Animation randomAnimation(CubeSize size, int frames, unsigned seed)
+{
+    std::mt19937 random(seed);
+    Animation animation;
+    animation.size = size;
+    for (int i = 0; i < frames; ++i)
+    {
+        Frame frame(size);
+        for (int led = 0; led < 24; ++led)
+            frame.set(random() % size.x, random() % size.y, random() % size.z, true);
+        frame.set(i % size.x, i / size.x % size.y, 0, true);
+        animation.frames.push_back(FrameHandle(std::move(frame)));
+    }
+    return animation;
+}
+
+// More frames than a thread keeps decoded, so lazy frames share addresses
+static void transformMapped(int version)
+{
+    std::string path = "cbin_map_test_" + std::to_string(version) + ".cbin";
+    Animation original = randomAnimation(CubeSize{8, 8, 8}, 40, version);
+    check(writeCBIN(path.c_str(), original, version), "write a .cbin");
+
+    Transform mirror;
+    mirror.kind = TRANSFORM_MIRROR;
+    mirror.axis = 0;
+    Animation mapped;
+    check(mapCBIN(path.c_str(), mapped), "map the .cbin");
+    transformFrames(mapped, 0, (int)mapped.frames.size(), mirror);
+    bool same = mapped.frames.size() == original.frames.size();
+    for (size_t i = 0; same && i < original.frames.size(); ++i)
+        same = *mapped.frames[i] == transformFrame(*original.frames[i], mirror);
+    check(same, "mirror every frame of a mapped file");
+
+    check(mapCBIN(path.c_str(), mapped), "map the .cbin again");
+    mapped.resize(CubeSize{16, 8, 8});
+    same = true;
+    for (size_t i = 0; same && i < original.frames.size(); ++i)
+    {
+        Frame expected = *original.frames[i];
+        expected.resize(CubeSize{16, 8, 8});
+        same = *mapped.frames[i] == expected;
+    }
+    check(same, "resize every frame of a mapped file");
+    std::remove(path.c_str());
+}
+
+static void overwrite(const std::string &path, const std::vector<char> &bytes)
+{
+    std::ofstream out(path, std::ios::binary);
+    out.write(bytes.data(), bytes.size());
+}
+
+// Broken files must not reach the animation, not even as dark frames
+static void importBroken(int version)
+{
+    std::string path = "cbin_map_test_broken.cbin";
+    Animation original = randomAnimation(CubeSize{8, 8, 8}, 40, 10 + version);
+    check(writeCBIN(path.c_str(), original, version), "write a .cbin");
+    std::vector<char> bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    Animation animation = randomAnimation(CubeSize{16, 8, 8}, 3, 99);
+    std::vector<char> cut(bytes.begin(), bytes.end() - bytes.size() / 3);
+    overwrite(path, cut);
+    check(!mapCBIN(path.c_str(), animation), "refuse a truncated file");
+
+    if (version == CBIN_V2)
+    {
+        // An unknown encoding on the last record, far from the header and the
+        // first frames
+        CbinHeader header;
+        size_t at = 0;
+        parseCbinHeader(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), bytes.size(), header, at);
+        for (uint32_t i = 0; i + 1 < header.frames; ++i)
+        {
+            uint32_t length;
+            std::memcpy(&length, &bytes[at + 1], 4);
+            at += CBIN_RECORD_HEADER + length;
+        }
+        std::vector<char> corrupt = bytes;
+        corrupt[at] = 0x7f;
+        overwrite(path, corrupt);
+        check(!mapCBIN(path.c_str(), animation), "refuse a file with a corrupt record");
+    }
+    check(animation.size == CubeSize{16, 8, 8} && animation.frames.size() == 3,
+          "leave the animation alone after a refused import");
+    std::remove(path.c_str());
+}
+
+int main()
+{
+    transformMapped(1);
+    transformMapped(2);
+    importBroken(1);
+    importBroken(2);
+    if (failures)
+        return 1;
+    std::printf("all passed\n");
+    return 0;
+}
\ No newline at end of file